@@ -0,0 +1,501 @@
+//
+//      布隆过滤器的替代品
+//
+//      1. 布谷鸟过滤器（Cuckoo Filter）- 支持删除
+//      2. 二元熔断过滤器（Binary Fuse Filter，xor 过滤器的改进版）- 静态集合，空间最省
+//
+//  接口和 boom_filter.h 保持一致：XXXInit / XXXSet / XXXTest / XXXDestroy，Test 存在返回0，不存在返回-1。
+//
+#ifndef ALGORITHM_ADVANCED_CUCKOO_XOR_FILTER_H
+#define ALGORITHM_ADVANCED_CUCKOO_XOR_FILTER_H
+#include <vector>
+#include <string>
+#include <chrono>
+#include <functional>
+#include "boom_filter.h"
+using namespace std;
+
+//-----------------------------------------------------------------------------------
+//
+//          "布谷鸟过滤器"的实现
+//
+//-----------------------------------------------------------------------------------
+// 布谷鸟过滤器（Fan et al. 《Cuckoo Filter: Practically Better Than Bloom》）不存位，存的是 key 的指纹：
+//  - 表由若干个桶组成，每个桶 4 个槽，每个槽放一个 16 位指纹，一个桶正好是一个 uint64_t
+//  - 每个 key 有两个候选桶：i1 = hash(key)，i2 = (hash(指纹) - i1) mod 桶数。
+//      i1 和 i2 用同一个公式互相转换，只知道指纹和其中一个桶也能算出另一个桶，所以踢出一个指纹时不需要原来的 key。
+//      论文里用的是 i1 ^ hash(指纹)，但异或要求桶数是 2 的幂，最坏会浪费一半空间；减法对任意桶数都成立
+//  - 插入：两个桶里有空槽就放进去；都满了就随机踢出一个指纹，把它挪到它的另一个桶，直到找到空槽（布谷鸟哈希）
+//  - 删除：在两个候选桶里找到相同的指纹删掉一个即可。这是布隆过滤器做不到的
+//  - 查询：只看两个桶，最多两次 cache miss。两个桶共 8 个槽，误判率约 8 / 2^16 ≈ 0.012%
+//  负载率可以到 95%，所以每个 key 约 16/0.95 ≈ 17 位。
+
+static const int CUCKOO_SLOTS = 4;
+static const int CUCKOO_MAX_KICKS = 500;
+
+typedef struct CuckooFilter{
+    uint64_t* _buckets;     // 每个桶 4 个 16 位指纹，0 表示空槽
+    size_t _nbuckets;
+    size_t _count;
+    uint64_t _rng;          // 踢出时选槽用的随机数状态
+
+    // 踢了 CUCKOO_MAX_KICKS 次还没放下的那个指纹先存在这里，表示表已经满了
+    int _hasVictim;
+    uint16_t _victimFp;
+    size_t _victimIndex;
+}CuckooFilter;
+
+uint16_t CuckooGetSlot(uint64_t bucket, int slot){
+    return (uint16_t)(bucket >> (slot * 16));
+}
+void CuckooSetSlot(uint64_t* bucket, int slot, uint16_t fp){
+    *bucket = (*bucket & ~((uint64_t)0xFFFF << (slot * 16))) | ((uint64_t)fp << (slot * 16));
+}
+
+// 判断一个桶的 4 个 16 位槽里有没有 fp：异或之后找全 0 的 16 位段（经典的 haszero 位运算技巧），没有分支
+int CuckooBucketHas(uint64_t bucket, uint16_t fp){
+    uint64_t x = bucket ^ (0x0001000100010001ULL * fp);
+    return ((x - 0x0001000100010001ULL) & ~x & 0x8000800080008000ULL) != 0;
+}
+
+size_t CuckooAltIndex(CuckooFilter* cf, size_t index, uint16_t fp){
+    size_t h = (size_t)(BloomMix64(fp) % cf->_nbuckets);
+    return h >= index ? h - index : h + cf->_nbuckets - index;
+}
+
+// 一个 64 位 hash 拆成指纹（低 16 位，0 留给空槽）和第一个桶（高 32 位）
+void CuckooHash(CuckooFilter* cf, KeyType key, uint16_t* fp, size_t* i1){
+    uint64_t h = MurmurHash64A(key, strlen(key), 0);
+    *fp = (uint16_t)h;
+    if (*fp == 0) *fp = 1;
+    *i1 = (size_t)(((h >> 32) * (uint64_t)cf->_nbuckets) >> 32);
+}
+
+// n: 预计最多放多少个 key
+void CuckooFilterInit(CuckooFilter* cf, size_t n){
+    assert(cf);
+    size_t nbuckets = (size_t)ceil((double)n / (CUCKOO_SLOTS * 0.95));
+    if (nbuckets < 2) nbuckets = 2;
+    assert(nbuckets <= ((size_t)1 << 32));   // 第一个桶只用了 hash 的高 32 位
+
+    cf->_nbuckets = nbuckets;
+    cf->_buckets = (uint64_t*)malloc(sizeof(uint64_t) * nbuckets);
+    assert(cf->_buckets);
+    memset(cf->_buckets, 0, sizeof(uint64_t) * nbuckets);
+    cf->_count = 0;
+    cf->_rng = 0x9E3779B97F4A7C15ULL;
+    cf->_hasVictim = 0;
+}
+
+int CuckooBucketInsert(CuckooFilter* cf, size_t index, uint16_t fp){
+    uint64_t* bucket = &cf->_buckets[index];
+    for (int s = 0; s < CUCKOO_SLOTS; s++){
+        if (CuckooGetSlot(*bucket, s) == 0){
+            CuckooSetSlot(bucket, s, fp);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// 插入成功返回0；表已满返回-1（此时 key 仍然能查到，但不能再插入新的 key）
+int CuckooFilterSet(CuckooFilter* cf, KeyType key){
+    assert(cf);
+    if (cf->_hasVictim)
+        return -1;
+
+    uint16_t fp;
+    size_t i1;
+    CuckooHash(cf, key, &fp, &i1);
+    size_t i2 = CuckooAltIndex(cf, i1, fp);
+    if (CuckooBucketInsert(cf, i1, fp) == 0 || CuckooBucketInsert(cf, i2, fp) == 0){
+        cf->_count++;
+        return 0;
+    }
+
+    // 两个桶都满了：随机踢出一个指纹，让它去它的另一个桶
+    size_t index = (cf->_rng & 1) ? i1 : i2;
+    for (int kick = 0; kick < CUCKOO_MAX_KICKS; kick++){
+        cf->_rng ^= cf->_rng << 13;
+        cf->_rng ^= cf->_rng >> 7;
+        cf->_rng ^= cf->_rng << 17;
+        int slot = (int)(cf->_rng % CUCKOO_SLOTS);
+
+        uint16_t old = CuckooGetSlot(cf->_buckets[index], slot);
+        CuckooSetSlot(&cf->_buckets[index], slot, fp);
+        fp = old;
+        index = CuckooAltIndex(cf, index, fp);
+        if (CuckooBucketInsert(cf, index, fp) == 0){
+            cf->_count++;
+            return 0;
+        }
+    }
+    cf->_hasVictim = 1;
+    cf->_victimFp = fp;
+    cf->_victimIndex = index;
+    cf->_count++;
+    return 0;
+}
+
+//存在返回0，不存在返回-1
+int CuckooFilterTest(CuckooFilter* cf, KeyType key){
+    assert(cf);
+    uint16_t fp;
+    size_t i1;
+    CuckooHash(cf, key, &fp, &i1);
+    size_t i2 = CuckooAltIndex(cf, i1, fp);
+    if (CuckooBucketHas(cf->_buckets[i1], fp) | CuckooBucketHas(cf->_buckets[i2], fp))
+        return 0;
+    if (cf->_hasVictim && cf->_victimFp == fp && (cf->_victimIndex == i1 || cf->_victimIndex == i2))
+        return 0;
+    return -1;
+}
+
+// 删除成功返回0，不存在返回-1。和计数布隆过滤器一样，只能删除确实插入过的 key
+int CuckooFilterRemove(CuckooFilter* cf, KeyType key){
+    assert(cf);
+    uint16_t fp;
+    size_t i1;
+    CuckooHash(cf, key, &fp, &i1);
+    size_t i2 = CuckooAltIndex(cf, i1, fp);
+
+    if (cf->_hasVictim && cf->_victimFp == fp && (cf->_victimIndex == i1 || cf->_victimIndex == i2)){
+        cf->_hasVictim = 0;
+        cf->_count--;
+        return 0;
+    }
+    size_t candidates[2] = {i1, i2};
+    for (size_t index : candidates){
+        for (int s = 0; s < CUCKOO_SLOTS; s++){
+            if (CuckooGetSlot(cf->_buckets[index], s) == fp){
+                CuckooSetSlot(&cf->_buckets[index], s, 0);
+                cf->_count--;
+                // 腾出了位置，把暂存的指纹放回表里
+                if (cf->_hasVictim){
+                    cf->_hasVictim = 0;
+                    size_t victimAlt = CuckooAltIndex(cf, cf->_victimIndex, cf->_victimFp);
+                    if (CuckooBucketInsert(cf, cf->_victimIndex, cf->_victimFp) != 0 &&
+                        CuckooBucketInsert(cf, victimAlt, cf->_victimFp) != 0){
+                        cf->_hasVictim = 1;
+                    }
+                }
+                return 0;
+            }
+        }
+    }
+    return -1;
+}
+
+void CuckooFilterDestroy(CuckooFilter* cf){
+    free(cf->_buckets);
+}
+
+
+//-----------------------------------------------------------------------------------
+//
+//          "二元熔断过滤器"的实现
+//
+//-----------------------------------------------------------------------------------
+// xor 过滤器（Graf & Lemire 2020）的思路：给每个 key 三个位置 h0,h1,h2，构造一个 8 位数组 F，使得
+//      F[h0] ^ F[h1] ^ F[h2] == fingerprint(key)
+//  查询时异或三个位置，等于指纹就认为存在，误判率 1/256 ≈ 0.39%。
+// 构造（"剥洋葱"）：统计每个位置被几个 key 用到，反复找只被一个 key 用到的位置，把这个 key 压栈并从其他两个位置摘掉；
+//  所有 key 都摘完后按出栈顺序赋值，每个 key 把自己唯一占用的位置设成 指纹 ^ 另外两个位置，之前赋好的值不会被破坏。
+//
+// 二元熔断过滤器（Graf & Lemire 2022 《Binary Fuse Filters》）把数组切成很多小段，一个 key 的三个位置落在相邻的三段里，
+//  局部性更好，剥离成功需要的空间从 1.23n 降到约 1.125n，即每个 key 约 9 位，而 1% 的布隆过滤器要 9.6 位。
+//  缺点：集合是静态的，一次性从 key 数组构造，之后不能插入也不能删除。
+
+static const int BINARY_FUSE_MAX_ITERATIONS = 100;
+
+typedef struct BinaryFuseFilter{
+    uint8_t* _fingerprints;
+    uint64_t _seed;
+    uint32_t _segmentLength;
+    uint32_t _segmentLengthMask;
+    uint32_t _segmentCount;
+    uint32_t _segmentCountLength;
+    uint32_t _arrayLength;
+}BinaryFuseFilter;
+
+uint64_t BinaryFuseMulhi(uint64_t a, uint64_t b){
+#if defined(__SIZEOF_INT128__)
+    return (uint64_t)(((__uint128_t)a * b) >> 64);
+#else
+    uint64_t aLo = (uint32_t)a, aHi = a >> 32, bLo = (uint32_t)b, bHi = b >> 32;
+    uint64_t mid = aHi * bLo + ((aLo * bLo) >> 32);
+    return aHi * bHi + (mid >> 32) + ((aLo * bHi + (uint32_t)mid) >> 32);
+#endif
+}
+
+uint8_t BinaryFuseFingerprint(uint64_t hash){
+    return (uint8_t)(hash ^ (hash >> 32));
+}
+
+// 第 index(0,1,2) 个位置：先选出起始段，再在后面相邻的段里各取一个位置
+uint32_t BinaryFuseHash(BinaryFuseFilter* bf, int index, uint64_t hash){
+    uint64_t h = BinaryFuseMulhi(hash, bf->_segmentCountLength);
+    h += (uint64_t)index * bf->_segmentLength;
+    uint64_t hh = hash & ((1ULL << 36) - 1);
+    h ^= (hh >> (36 - 18 * index)) & bf->_segmentLengthMask;
+    return (uint32_t)h;
+}
+
+uint64_t BinaryFuseKeyHash(BinaryFuseFilter* bf, uint64_t keyHash){
+    return BloomMix64(keyHash + bf->_seed);
+}
+
+// 段长和空间系数是论文里对 3 路熔断实验得出的参数
+void BinaryFuseFilterAllocate(BinaryFuseFilter* bf, uint32_t size){
+    const uint32_t arity = 3;
+    bf->_segmentLength = size == 0 ? 4 : (uint32_t)1 << (int)floor(log((double)size) / log(3.33) + 2.25);
+    if (bf->_segmentLength > 262144) bf->_segmentLength = 262144;
+    bf->_segmentLengthMask = bf->_segmentLength - 1;
+    double sizeFactor = size <= 1 ? 0 : fmax(1.125, 0.875 + 0.25 * log(1000000.0) / log((double)size));
+    uint32_t capacity = size <= 1 ? 0 : (uint32_t)round((double)size * sizeFactor);
+    uint32_t initSegmentCount = (capacity + bf->_segmentLength - 1) / bf->_segmentLength;
+    initSegmentCount = initSegmentCount > arity - 1 ? initSegmentCount - (arity - 1) : 1;
+    bf->_arrayLength = (initSegmentCount + arity - 1) * bf->_segmentLength;
+    bf->_segmentCount = (bf->_arrayLength + bf->_segmentLength - 1) / bf->_segmentLength;
+    bf->_segmentCount = bf->_segmentCount <= arity - 1 ? 1 : bf->_segmentCount - (arity - 1);
+    bf->_arrayLength = (bf->_segmentCount + arity - 1) * bf->_segmentLength;
+    bf->_segmentCountLength = bf->_segmentCount * bf->_segmentLength;
+    bf->_fingerprints = (uint8_t*)malloc(bf->_arrayLength);
+    assert(bf->_fingerprints);
+    memset(bf->_fingerprints, 0, bf->_arrayLength);
+}
+
+// 从 n 个 key 一次性构造，key 可以有重复。成功返回0，失败（极小概率，换了 100 次种子都剥不开）返回-1
+int BinaryFuseFilterInit(BinaryFuseFilter* bf, KeyType* keys, size_t n){
+    assert(bf);
+    assert(n < ((size_t)1 << 32));
+    uint32_t size = (uint32_t)n;
+    BinaryFuseFilterAllocate(bf, size);
+
+    vector<uint64_t> keyHashes(size);
+    for (uint32_t i = 0; i < size; i++){
+        keyHashes[i] = MurmurHash64A(keys[i], strlen(keys[i]), 0);
+    }
+
+    uint32_t capacity = bf->_arrayLength;
+    vector<uint64_t> reverseOrder(size + 1, 0);
+    vector<uint32_t> alone(capacity);
+    vector<uint8_t> t2count(capacity, 0);     // 高 6 位：用到该位置的 key 数；低 2 位：这些 key 在该位置的 index 的异或
+    vector<uint64_t> t2hash(capacity, 0);     // 用到该位置的 key 的 hash 的异或，只剩一个 key 时就是它本身
+    vector<uint8_t> reverseH(size);
+    uint32_t blockBits = 1;
+    while (((uint32_t)1 << blockBits) < bf->_segmentCount) blockBits++;
+    uint32_t block = (uint32_t)1 << blockBits;
+    vector<uint32_t> startPos(block);
+    uint64_t rng = 0x726b2b9d438b9d4dULL;
+    uint32_t stackSize = 0;
+
+    reverseOrder[size] = 1;
+    for (int loop = 0; ; loop++){
+        if (loop >= BINARY_FUSE_MAX_ITERATIONS){
+            free(bf->_fingerprints);
+            bf->_fingerprints = NULL;
+            return -1;
+        }
+        rng += 0x9E3779B97F4A7C15ULL;
+        bf->_seed = BloomMix64(rng);
+
+        // 按起始段分桶排一下序，剥离时访问更集中
+        for (uint32_t i = 0; i < block; i++){
+            startPos[i] = (uint32_t)(((uint64_t)i * size) >> blockBits);
+        }
+        for (uint32_t i = 0; i < size; i++){
+            uint64_t hash = BinaryFuseKeyHash(bf, keyHashes[i]);
+            uint32_t segment = (uint32_t)(hash >> (64 - blockBits));
+            while (reverseOrder[startPos[segment]] != 0){
+                segment = (segment + 1) & (block - 1);
+            }
+            reverseOrder[startPos[segment]] = hash;
+            startPos[segment]++;
+        }
+
+        int error = 0;
+        uint32_t duplicates = 0;
+        for (uint32_t i = 0; i < size; i++){
+            uint64_t hash = reverseOrder[i];
+            uint32_t h0 = BinaryFuseHash(bf, 0, hash);
+            uint32_t h1 = BinaryFuseHash(bf, 1, hash);
+            uint32_t h2 = BinaryFuseHash(bf, 2, hash);
+            t2count[h0] += 4;
+            t2hash[h0] ^= hash;
+            t2count[h1] += 4;
+            t2count[h1] ^= 1;
+            t2hash[h1] ^= hash;
+            t2count[h2] += 4;
+            t2count[h2] ^= 2;
+            t2hash[h2] ^= hash;
+            // 重复的 key：两个相同 hash 异或成 0，撤销第二次
+            if ((t2hash[h0] & t2hash[h1] & t2hash[h2]) == 0){
+                if ((t2hash[h0] == 0 && t2count[h0] == 8) || (t2hash[h1] == 0 && t2count[h1] == 8) ||
+                    (t2hash[h2] == 0 && t2count[h2] == 8)){
+                    duplicates++;
+                    t2count[h0] -= 4;
+                    t2hash[h0] ^= hash;
+                    t2count[h1] -= 4;
+                    t2count[h1] ^= 1;
+                    t2hash[h1] ^= hash;
+                    t2count[h2] -= 4;
+                    t2count[h2] ^= 2;
+                    t2hash[h2] ^= hash;
+                }
+            }
+            // 计数溢出（一个位置被 64 个以上的 key 用到）
+            if (t2count[h0] < 4 || t2count[h1] < 4 || t2count[h2] < 4) error = 1;
+        }
+
+        if (!error){
+            // 只被一个 key 用到的位置入队，逐个剥离
+            uint32_t qsize = 0;
+            for (uint32_t i = 0; i < capacity; i++){
+                alone[qsize] = i;
+                qsize += (t2count[i] >> 2) == 1 ? 1 : 0;
+            }
+            stackSize = 0;
+            while (qsize > 0){
+                qsize--;
+                uint32_t index = alone[qsize];
+                if ((t2count[index] >> 2) != 1) continue;
+
+                uint64_t hash = t2hash[index];
+                uint32_t h012[5];
+                h012[0] = BinaryFuseHash(bf, 0, hash);
+                h012[1] = BinaryFuseHash(bf, 1, hash);
+                h012[2] = BinaryFuseHash(bf, 2, hash);
+                h012[3] = h012[0];
+                h012[4] = h012[1];
+                uint8_t found = t2count[index] & 3;
+                reverseH[stackSize] = found;
+                reverseOrder[stackSize] = hash;
+                stackSize++;
+
+                for (int j = 1; j <= 2; j++){
+                    uint32_t other = h012[found + j];
+                    alone[qsize] = other;
+                    qsize += (t2count[other] >> 2) == 2 ? 1 : 0;
+                    t2count[other] -= 4;
+                    t2count[other] ^= (found + j) % 3;
+                    t2hash[other] ^= hash;
+                }
+            }
+            if (stackSize + duplicates == size) break;
+        }
+        // 剥不开：换一个种子重来
+        fill(reverseOrder.begin(), reverseOrder.begin() + size, 0);
+        fill(t2count.begin(), t2count.end(), 0);
+        fill(t2hash.begin(), t2hash.end(), 0);
+    }
+
+    // 逆序赋值
+    for (uint32_t i = stackSize; i-- > 0; ){
+        uint64_t hash = reverseOrder[i];
+        uint32_t h012[5];
+        h012[0] = BinaryFuseHash(bf, 0, hash);
+        h012[1] = BinaryFuseHash(bf, 1, hash);
+        h012[2] = BinaryFuseHash(bf, 2, hash);
+        h012[3] = h012[0];
+        h012[4] = h012[1];
+        uint8_t found = reverseH[i];
+        bf->_fingerprints[h012[found]] = BinaryFuseFingerprint(hash) ^
+                bf->_fingerprints[h012[found + 1]] ^ bf->_fingerprints[h012[found + 2]];
+    }
+    return 0;
+}
+
+//存在返回0，不存在返回-1
+int BinaryFuseFilterTest(BinaryFuseFilter* bf, KeyType key){
+    assert(bf && bf->_fingerprints);
+    uint64_t hash = BinaryFuseKeyHash(bf, MurmurHash64A(key, strlen(key), 0));
+    uint8_t f = BinaryFuseFingerprint(hash);
+    f ^= bf->_fingerprints[BinaryFuseHash(bf, 0, hash)] ^
+         bf->_fingerprints[BinaryFuseHash(bf, 1, hash)] ^
+         bf->_fingerprints[BinaryFuseHash(bf, 2, hash)];
+    return f == 0 ? 0 : -1;
+}
+
+void BinaryFuseFilterDestroy(BinaryFuseFilter* bf){
+    free(bf->_fingerprints);
+}
+
+
+// 对比：每个 key 占多少位、误判率、查询耗时
+//  BloomFilter 的位图每个 size_t 只用了低 32 位，所以实际内存是 range 的两倍，这里按实际占用的内存算
+void BenchFilterAlternatives(){
+    const size_t n = 1000000;
+    vector<string> storage;
+    char buf[32];
+    for (size_t i = 0; i < 2 * n; i++){
+        snprintf(buf, sizeof(buf), i < n ? "key-%zu" : "miss-%zu", i);
+        storage.push_back(buf);
+    }
+    vector<KeyType> keys;
+    for (auto& s : storage) keys.push_back(&s[0]);
+
+    auto report = [&](const char* name, double bytes, const function<int(KeyType)>& test){
+        size_t falseNegative = 0, falsePositive = 0;
+        for (size_t i = 0; i < n; i++){
+            if (test(keys[i]) == -1) falseNegative++;
+        }
+        auto t0 = chrono::steady_clock::now();
+        for (size_t i = n; i < 2 * n; i++){
+            if (test(keys[i]) == 0) falsePositive++;
+        }
+        auto t1 = chrono::steady_clock::now();
+        printf("%-14s bits/key=%6.2f fpp=%.5f lookup=%6.1fns/op false negative=%zu\n", name, bytes * 8 / n,
+               (double)falsePositive / n, chrono::duration<double, nano>(t1 - t0).count() / n, falseNegative);
+    };
+
+    BloomFilter bf;
+    BloomFilterInit(&bf, n * 10);
+    for (size_t i = 0; i < n; i++) BloomFilterSet(&bf, keys[i]);
+    report("BloomFilter", sizeof(size_t) * ((bf._bm._range >> 5) + 1.0),
+           [&](KeyType key){ return BloomFilterTest(&bf, key); });
+    BloomFilterDestroy(&bf);
+
+    BlockedBloomFilter bbf;
+    BlockedBloomFilterInit(&bbf, n, 0.01);
+    for (size_t i = 0; i < n; i++) BlockedBloomFilterSet(&bbf, keys[i]);
+    report("BlockedBloom", bbf._nblocks * 64.0, [&](KeyType key){ return BlockedBloomFilterTest(&bbf, key); });
+    BlockedBloomFilterDestroy(&bbf);
+
+    CuckooFilter cf;
+    CuckooFilterInit(&cf, n);
+    for (size_t i = 0; i < n; i++) CuckooFilterSet(&cf, keys[i]);
+    report("CuckooFilter", cf._nbuckets * 8.0, [&](KeyType key){ return CuckooFilterTest(&cf, key); });
+    CuckooFilterDestroy(&cf);
+
+    BinaryFuseFilter fuse;
+    if (BinaryFuseFilterInit(&fuse, keys.data(), n) == 0){
+        report("BinaryFuse8", (double)fuse._arrayLength, [&](KeyType key){ return BinaryFuseFilterTest(&fuse, key); });
+        BinaryFuseFilterDestroy(&fuse);
+    }
+}
+
+void TestCuckooFilter(){
+    CuckooFilter cf;
+    CuckooFilterInit(&cf, 1000);
+    char key[32];
+    for (int i = 0; i < 1000; i++){
+        snprintf(key, sizeof(key), "key-%d", i);
+        CuckooFilterSet(&cf, key);
+    }
+    for (int i = 0; i < 500; i++){
+        snprintf(key, sizeof(key), "key-%d", i);
+        CuckooFilterRemove(&cf, key);
+    }
+    int stillThere = 0, falseNegative = 0;
+    for (int i = 0; i < 1000; i++){
+        snprintf(key, sizeof(key), "key-%d", i);
+        int r = CuckooFilterTest(&cf, key);
+        if (i < 500 && r == 0) stillThere++;
+        if (i >= 500 && r == -1) falseNegative++;
+    }
+    printf("count=%zu removed but still reported=%d false negative=%d\n", cf._count, stillThere, falseNegative);
+    CuckooFilterDestroy(&cf);
+}
+
+#endif //ALGORITHM_ADVANCED_CUCKOO_XOR_FILTER_H
@@ -0,0 +1,749 @@
+//
+//      压缩位图（Roaring Bitmap）
+//
+//      1. 三种容器：数组 / 位图 / 行程（run）
+//      2. 并集、交集、基数
+//      3. 序列化（与 CRoaring / Java RoaringBitmap 的可移植格式兼容）
+//
+//  BitMap 按 range 一次性分配 range/32 个字，在 2^32 的空间里只标记 1 万个 ID 也要 2^27 个字。
+//  Roaring（Chambi, Lemire et al.）把 32 位空间按高 16 位切成 2^16 个容器，只给出现过的高 16 位建容器，
+//  每个容器放低 16 位，按内容选最小的表示：
+//      - 数组容器：有序的 uint16 数组，元素不超过 4096 个时用，每个元素 2 字节
+//      - 位图容器：2^16 位 = 1024 个 uint64 = 8KB，元素超过 4096 个时比数组省
+//      - 行程容器：(起点, 长度-1) 对，连续的 ID 段只要 4 字节，适合大段连续的 ID
+//  数组和位图之间在 Set/Reset 时按 4096 自动转换；行程容器的选择需要统计段数，
+//  在 RoaringBitMapOptimize 和并/交运算的结果上做。
+//
+//  接口和 BitMap 保持一致：RoaringBitMapInit / Set / Reset / Test / Destroy，Test 存在返回0，不存在返回-1。
+//
+#ifndef ALGORITHM_ADVANCED_ROARING_BITMAP_H
+#define ALGORITHM_ADVANCED_ROARING_BITMAP_H
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+using namespace std;
+
+static const uint32_t ROARING_ARRAY_MAX = 4096;     // 数组容器最多 4096 个元素，再多就不如位图容器省
+static const uint32_t ROARING_BITSET_WORDS = 1024;
+
+enum RoaringContainerType{
+    ROARING_ARRAY = 1,
+    ROARING_BITSET = 2,
+    ROARING_RUN = 3,
+};
+
+typedef struct RoaringRun{
+    uint16_t start;
+    uint16_t length;    // 段长 - 1，这样 [0, 65535] 整段也放得下
+}RoaringRun;
+
+typedef struct RoaringContainer{
+    int _type;
+    uint32_t _card;             // 元素个数
+    vector<uint16_t> _array;    // ROARING_ARRAY 时使用
+    vector<uint64_t> _bitset;   // ROARING_BITSET 时使用
+    vector<RoaringRun> _runs;   // ROARING_RUN 时使用，按 start 有序且互不相邻
+}RoaringContainer;
+
+typedef struct RoaringBitMap{
+    vector<uint16_t> _keys;                 // 有序的高 16 位
+    vector<RoaringContainer> _containers;   // 和 _keys 一一对应
+}RoaringBitMap;
+
+
+//-----------------------------------------------------------------------------------
+//
+//          容器的实现
+//
+//-----------------------------------------------------------------------------------
+
+// 最后一个 start <= low 的段的下标 + 1，没有则返回 0
+size_t RoaringRunUpper(const vector<RoaringRun>& runs, uint16_t low){
+    return upper_bound(runs.begin(), runs.end(), low,
+                       [](uint16_t v, const RoaringRun& r){ return v < r.start; }) - runs.begin();
+}
+
+void RoaringBitsetSetRange(uint64_t* bits, uint32_t lo, uint32_t hi){     // [lo, hi]
+    uint32_t lw = lo >> 6, hw = hi >> 6;
+    uint64_t lmask = ~(uint64_t)0 << (lo & 63);
+    uint64_t hmask = ~(uint64_t)0 >> (63 - (hi & 63));
+    if (lw == hw){
+        bits[lw] |= lmask & hmask;
+        return;
+    }
+    bits[lw] |= lmask;
+    for (uint32_t w = lw + 1; w < hw; w++) bits[w] = ~(uint64_t)0;
+    bits[hw] |= hmask;
+}
+
+uint32_t RoaringBitsetCount(const uint64_t* bits){
+    uint32_t card = 0;
+    for (uint32_t i = 0; i < ROARING_BITSET_WORDS; i++){
+        card += __builtin_popcountll(bits[i]);
+    }
+    return card;
+}
+
+// 把容器的内容或进一个 1024 字的位图，不改变容器本身
+void RoaringContainerOrInto(const RoaringContainer* c, uint64_t* bits){
+    if (c->_type == ROARING_ARRAY){
+        for (uint16_t v : c->_array) bits[v >> 6] |= (uint64_t)1 << (v & 63);
+    }
+    else if (c->_type == ROARING_BITSET){
+        for (uint32_t i = 0; i < ROARING_BITSET_WORDS; i++) bits[i] |= c->_bitset[i];
+    }
+    else{
+        for (const RoaringRun& r : c->_runs) RoaringBitsetSetRange(bits, r.start, (uint32_t)r.start + r.length);
+    }
+}
+
+// 按顺序取出容器的所有值
+void RoaringContainerValues(const RoaringContainer* c, vector<uint16_t>& out){
+    out.clear();
+    out.reserve(c->_card);
+    if (c->_type == ROARING_ARRAY){
+        out = c->_array;
+    }
+    else if (c->_type == ROARING_BITSET){
+        for (uint32_t i = 0; i < ROARING_BITSET_WORDS; i++){
+            for (uint64_t w = c->_bitset[i]; w; w &= w - 1){
+                out.push_back((uint16_t)(i * 64 + __builtin_ctzll(w)));
+            }
+        }
+    }
+    else{
+        for (const RoaringRun& r : c->_runs){
+            for (uint32_t v = r.start; v <= (uint32_t)r.start + r.length; v++) out.push_back((uint16_t)v);
+        }
+    }
+}
+
+void RoaringToBitset(RoaringContainer* c){
+    if (c->_type == ROARING_BITSET) return;
+    vector<uint64_t> bits(ROARING_BITSET_WORDS, 0);
+    RoaringContainerOrInto(c, bits.data());
+    c->_bitset.swap(bits);
+    vector<uint16_t>().swap(c->_array);
+    vector<RoaringRun>().swap(c->_runs);
+    c->_type = ROARING_BITSET;
+}
+
+void RoaringToArray(RoaringContainer* c){
+    if (c->_type == ROARING_ARRAY) return;
+    vector<uint16_t> values;
+    RoaringContainerValues(c, values);
+    c->_array.swap(values);
+    vector<uint64_t>().swap(c->_bitset);
+    vector<RoaringRun>().swap(c->_runs);
+    c->_type = ROARING_ARRAY;
+}
+
+void RoaringToRuns(RoaringContainer* c){
+    if (c->_type == ROARING_RUN) return;
+    vector<uint16_t> values;
+    RoaringContainerValues(c, values);
+    vector<RoaringRun> runs;
+    for (size_t i = 0; i < values.size(); i++){
+        if (!runs.empty() && (uint32_t)runs.back().start + runs.back().length + 1 == values[i]){
+            runs.back().length++;
+        }
+        else{
+            runs.push_back(RoaringRun{values[i], 0});
+        }
+    }
+    c->_runs.swap(runs);
+    vector<uint16_t>().swap(c->_array);
+    vector<uint64_t>().swap(c->_bitset);
+    c->_type = ROARING_RUN;
+}
+
+size_t RoaringCountRuns(const RoaringContainer* c){
+    if (c->_type == ROARING_RUN) return c->_runs.size();
+    size_t runs = 0;
+    if (c->_type == ROARING_ARRAY){
+        for (size_t i = 0; i < c->_array.size(); i++){
+            if (i == 0 || c->_array[i] != c->_array[i - 1] + 1) runs++;
+        }
+        return runs;
+    }
+    // 一段的起点 = 自己是 1 且前一位是 0
+    uint64_t carry = 0;
+    for (uint32_t i = 0; i < ROARING_BITSET_WORDS; i++){
+        uint64_t w = c->_bitset[i];
+        runs += __builtin_popcountll(w & ~((w << 1) | carry));
+        carry = w >> 63;
+    }
+    return runs;
+}
+
+// 序列化后的字节数就是内存里的主要开销：数组 2*card，位图 8192，行程 2 + 4*段数
+void RoaringContainerOptimize(RoaringContainer* c){
+    size_t runBytes = 2 + 4 * RoaringCountRuns(c);
+    size_t arrayBytes = 2 * (size_t)c->_card;
+    size_t bitsetBytes = ROARING_BITSET_WORDS * 8;
+    if (runBytes < min(arrayBytes, bitsetBytes)) RoaringToRuns(c);
+    else if (c->_card <= ROARING_ARRAY_MAX) RoaringToArray(c);
+    else RoaringToBitset(c);
+}
+
+int RoaringContainerContains(const RoaringContainer* c, uint16_t low){
+    if (c->_type == ROARING_ARRAY){
+        return binary_search(c->_array.begin(), c->_array.end(), low);
+    }
+    if (c->_type == ROARING_BITSET){
+        return (int)((c->_bitset[low >> 6] >> (low & 63)) & 1);
+    }
+    size_t i = RoaringRunUpper(c->_runs, low);
+    return i > 0 && low <= (uint32_t)c->_runs[i - 1].start + c->_runs[i - 1].length;
+}
+
+// 新加入返回1，本来就有返回0
+int RoaringContainerAdd(RoaringContainer* c, uint16_t low){
+    if (c->_type == ROARING_ARRAY){
+        auto it = lower_bound(c->_array.begin(), c->_array.end(), low);
+        if (it != c->_array.end() && *it == low) return 0;
+        if (c->_card < ROARING_ARRAY_MAX){
+            c->_array.insert(it, low);
+            c->_card++;
+            return 1;
+        }
+        RoaringToBitset(c);
+    }
+    if (c->_type == ROARING_BITSET){
+        uint64_t bit = (uint64_t)1 << (low & 63);
+        if (c->_bitset[low >> 6] & bit) return 0;
+        c->_bitset[low >> 6] |= bit;
+        c->_card++;
+        return 1;
+    }
+
+    vector<RoaringRun>& runs = c->_runs;
+    size_t i = RoaringRunUpper(runs, low);
+    if (i > 0){
+        RoaringRun& prev = runs[i - 1];
+        uint32_t end = (uint32_t)prev.start + prev.length;
+        if (low <= end) return 0;
+        if (low == end + 1){    // 接在前一段后面，可能还要和后一段合并
+            prev.length++;
+            if (i < runs.size() && runs[i].start == (uint32_t)low + 1){
+                prev.length += runs[i].length + 1;
+                runs.erase(runs.begin() + i);
+            }
+            c->_card++;
+            return 1;
+        }
+    }
+    if (i < runs.size() && runs[i].start == (uint32_t)low + 1){     // 接在后一段前面
+        runs[i].start = low;
+        runs[i].length++;
+    }
+    else{
+        runs.insert(runs.begin() + i, RoaringRun{low, 0});
+    }
+    c->_card++;
+    return 1;
+}
+
+// 删除成功返回1，本来就没有返回0
+int RoaringContainerRemove(RoaringContainer* c, uint16_t low){
+    if (c->_type == ROARING_ARRAY){
+        auto it = lower_bound(c->_array.begin(), c->_array.end(), low);
+        if (it == c->_array.end() || *it != low) return 0;
+        c->_array.erase(it);
+        c->_card--;
+        return 1;
+    }
+    if (c->_type == ROARING_BITSET){
+        uint64_t bit = (uint64_t)1 << (low & 63);
+        if (!(c->_bitset[low >> 6] & bit)) return 0;
+        c->_bitset[low >> 6] &= ~bit;
+        c->_card--;
+        if (c->_card <= ROARING_ARRAY_MAX) RoaringToArray(c);
+        return 1;
+    }
+
+    vector<RoaringRun>& runs = c->_runs;
+    size_t i = RoaringRunUpper(runs, low);
+    if (i == 0) return 0;
+    RoaringRun& r = runs[i - 1];
+    uint32_t end = (uint32_t)r.start + r.length;
+    if (low > end) return 0;
+    if (r.length == 0){
+        runs.erase(runs.begin() + (i - 1));
+    }
+    else if (low == r.start){
+        r.start++;
+        r.length--;
+    }
+    else if (low == end){
+        r.length--;
+    }
+    else{   // 从中间断开成两段
+        RoaringRun right{(uint16_t)(low + 1), (uint16_t)(end - low - 1)};
+        r.length = (uint16_t)(low - r.start - 1);
+        runs.insert(runs.begin() + i, right);
+    }
+    c->_card--;
+    return 1;
+}
+
+// a = a | b
+void RoaringContainerOr(RoaringContainer* a, const RoaringContainer* b){
+    if (a->_type == ROARING_ARRAY && b->_type == ROARING_ARRAY && a->_card + b->_card <= ROARING_ARRAY_MAX){
+        vector<uint16_t> merged;
+        merged.reserve(a->_card + b->_card);
+        set_union(a->_array.begin(), a->_array.end(), b->_array.begin(), b->_array.end(), back_inserter(merged));
+        a->_array.swap(merged);
+        a->_card = (uint32_t)a->_array.size();
+    }
+    else{
+        RoaringToBitset(a);
+        RoaringContainerOrInto(b, a->_bitset.data());
+        a->_card = RoaringBitsetCount(a->_bitset.data());
+    }
+    RoaringContainerOptimize(a);
+}
+
+// a = a & b
+void RoaringContainerAnd(RoaringContainer* a, const RoaringContainer* b){
+    if (a->_type == ROARING_ARRAY || b->_type == ROARING_ARRAY){
+        // 有一边是数组：结果一定不超过数组的大小，只需要逐个检查数组里的元素
+        const RoaringContainer* small = a->_type == ROARING_ARRAY ? a : b;
+        const RoaringContainer* other = small == a ? b : a;
+        vector<uint16_t> result;
+        if (other->_type == ROARING_ARRAY){
+            set_intersection(small->_array.begin(), small->_array.end(),
+                             other->_array.begin(), other->_array.end(), back_inserter(result));
+        }
+        else{
+            for (uint16_t v : small->_array){
+                if (RoaringContainerContains(other, v)) result.push_back(v);
+            }
+        }
+        a->_array.swap(result);
+        vector<uint64_t>().swap(a->_bitset);
+        vector<RoaringRun>().swap(a->_runs);
+        a->_type = ROARING_ARRAY;
+        a->_card = (uint32_t)a->_array.size();
+    }
+    else{
+        RoaringToBitset(a);
+        uint64_t bits[ROARING_BITSET_WORDS] = {0};
+        RoaringContainerOrInto(b, bits);
+        for (uint32_t i = 0; i < ROARING_BITSET_WORDS; i++) a->_bitset[i] &= bits[i];
+        a->_card = RoaringBitsetCount(a->_bitset.data());
+    }
+    if (a->_card > 0) RoaringContainerOptimize(a);
+}
+
+size_t RoaringContainerBytes(const RoaringContainer* c){
+    return sizeof(RoaringContainer) + c->_array.capacity() * sizeof(uint16_t) +
+           c->_bitset.capacity() * sizeof(uint64_t) + c->_runs.capacity() * sizeof(RoaringRun);
+}
+
+
+//-----------------------------------------------------------------------------------
+//
+//          "压缩位图"的实现
+//
+//-----------------------------------------------------------------------------------
+
+void RoaringBitMapInit(RoaringBitMap* rb){
+    assert(rb);
+    rb->_keys.clear();
+    rb->_containers.clear();
+}
+
+// 高 16 位对应的容器下标，不存在返回 -1
+long RoaringBitMapFind(const RoaringBitMap* rb, uint16_t high){
+    auto it = lower_bound(rb->_keys.begin(), rb->_keys.end(), high);
+    if (it == rb->_keys.end() || *it != high) return -1;
+    return it - rb->_keys.begin();
+}
+
+void RoaringBitMapSet(RoaringBitMap* rb, uint32_t x){
+    assert(rb);
+    uint16_t high = (uint16_t)(x >> 16);
+    auto it = lower_bound(rb->_keys.begin(), rb->_keys.end(), high);
+    size_t i = it - rb->_keys.begin();
+    if (it == rb->_keys.end() || *it != high){
+        RoaringContainer c;
+        c._type = ROARING_ARRAY;
+        c._card = 0;
+        rb->_keys.insert(it, high);
+        rb->_containers.insert(rb->_containers.begin() + i, c);
+    }
+    RoaringContainerAdd(&rb->_containers[i], (uint16_t)x);
+}
+
+void RoaringBitMapReset(RoaringBitMap* rb, uint32_t x){
+    assert(rb);
+    long i = RoaringBitMapFind(rb, (uint16_t)(x >> 16));
+    if (i < 0) return;
+    RoaringContainerRemove(&rb->_containers[i], (uint16_t)x);
+    if (rb->_containers[i]._card == 0){
+        rb->_keys.erase(rb->_keys.begin() + i);
+        rb->_containers.erase(rb->_containers.begin() + i);
+    }
+}
+
+//存在返回0，不存在返回-1
+int RoaringBitMapTest(const RoaringBitMap* rb, uint32_t x){
+    assert(rb);
+    long i = RoaringBitMapFind(rb, (uint16_t)(x >> 16));
+    if (i >= 0 && RoaringContainerContains(&rb->_containers[i], (uint16_t)x))
+        return 0;
+    return -1;
+}
+
+uint64_t RoaringBitMapCardinality(const RoaringBitMap* rb){
+    uint64_t card = 0;
+    for (const RoaringContainer& c : rb->_containers) card += c._card;
+    return card;
+}
+
+// 每个容器换成最省空间的表示，批量插入完之后调用一次
+void RoaringBitMapOptimize(RoaringBitMap* rb){
+    for (RoaringContainer& c : rb->_containers) RoaringContainerOptimize(&c);
+}
+
+// dst = dst | src：两边的 key 按顺序归并，只有相同的高 16 位才需要合并容器
+void RoaringBitMapOr(RoaringBitMap* dst, const RoaringBitMap* src){
+    assert(dst && src);
+    vector<uint16_t> keys;
+    vector<RoaringContainer> containers;
+    size_t i = 0, j = 0;
+    while (i < dst->_keys.size() || j < src->_keys.size()){
+        if (j == src->_keys.size() || (i < dst->_keys.size() && dst->_keys[i] < src->_keys[j])){
+            keys.push_back(dst->_keys[i]);
+            containers.push_back(std::move(dst->_containers[i++]));
+        }
+        else if (i == dst->_keys.size() || src->_keys[j] < dst->_keys[i]){
+            keys.push_back(src->_keys[j]);
+            containers.push_back(src->_containers[j++]);
+        }
+        else{
+            RoaringContainerOr(&dst->_containers[i], &src->_containers[j++]);
+            keys.push_back(dst->_keys[i]);
+            containers.push_back(std::move(dst->_containers[i++]));
+        }
+    }
+    dst->_keys.swap(keys);
+    dst->_containers.swap(containers);
+}
+
+// dst = dst & src：只有两边都有的高 16 位才可能留下
+void RoaringBitMapAnd(RoaringBitMap* dst, const RoaringBitMap* src){
+    assert(dst && src);
+    vector<uint16_t> keys;
+    vector<RoaringContainer> containers;
+    size_t i = 0, j = 0;
+    while (i < dst->_keys.size() && j < src->_keys.size()){
+        if (dst->_keys[i] < src->_keys[j]) i++;
+        else if (src->_keys[j] < dst->_keys[i]) j++;
+        else{
+            RoaringContainerAnd(&dst->_containers[i], &src->_containers[j++]);
+            if (dst->_containers[i]._card > 0){
+                keys.push_back(dst->_keys[i]);
+                containers.push_back(std::move(dst->_containers[i]));
+            }
+            i++;
+        }
+    }
+    dst->_keys.swap(keys);
+    dst->_containers.swap(containers);
+}
+
+// 按从小到大的顺序取出所有值
+void RoaringBitMapToArray(const RoaringBitMap* rb, vector<uint32_t>& out){
+    out.clear();
+    vector<uint16_t> values;
+    for (size_t i = 0; i < rb->_keys.size(); i++){
+        RoaringContainerValues(&rb->_containers[i], values);
+        for (uint16_t v : values) out.push_back(((uint32_t)rb->_keys[i] << 16) | v);
+    }
+}
+
+size_t RoaringBitMapBytes(const RoaringBitMap* rb){
+    size_t bytes = sizeof(RoaringBitMap) + rb->_keys.capacity() * sizeof(uint16_t);
+    for (const RoaringContainer& c : rb->_containers) bytes += RoaringContainerBytes(&c);
+    return bytes;
+}
+
+void RoaringBitMapDestroy(RoaringBitMap* rb){
+    vector<uint16_t>().swap(rb->_keys);
+    vector<RoaringContainer>().swap(rb->_containers);
+}
+
+
+//-----------------------------------------------------------------------------------
+//
+//          序列化
+//
+//-----------------------------------------------------------------------------------
+// 采用 Roaring 官方的可移植格式（RoaringFormatSpec），全部小端，其他语言的 Roaring 实现可以直接读：
+//  - cookie：没有行程容器时是 uint32 12346 + uint32 容器数；
+//           有行程容器时是 uint32 (12347 | (容器数-1) << 16)，后面跟 (容器数+7)/8 字节的"是否行程容器"标记位
+//  - 每个容器一个描述：uint16 高16位 + uint16 (基数-1)
+//  - 没有行程容器，或者容器数 >= 4 时，每个容器一个 uint32 偏移
+//  - 容器数据：数组 = 基数个 uint16；位图 = 1024 个 uint64；行程 = uint16 段数 + 段数个 (start, length-1)
+//  读的时候不是行程容器就按基数区分：> 4096 是位图，否则是数组。
+
+static const uint32_t ROARING_SERIAL_COOKIE_NO_RUN = 12346;
+static const uint32_t ROARING_SERIAL_COOKIE = 12347;
+static const size_t ROARING_NO_OFFSET_THRESHOLD = 4;
+
+void RoaringWrite16(char*& p, uint16_t v){ p[0] = (char)v; p[1] = (char)(v >> 8); p += 2; }
+void RoaringWrite32(char*& p, uint32_t v){ RoaringWrite16(p, (uint16_t)v); RoaringWrite16(p, (uint16_t)(v >> 16)); }
+void RoaringWrite64(char*& p, uint64_t v){ RoaringWrite32(p, (uint32_t)v); RoaringWrite32(p, (uint32_t)(v >> 32)); }
+uint16_t RoaringRead16(const char* p){ return (uint16_t)((uint8_t)p[0] | ((uint16_t)(uint8_t)p[1] << 8)); }
+uint32_t RoaringRead32(const char* p){ return RoaringRead16(p) | ((uint32_t)RoaringRead16(p + 2) << 16); }
+uint64_t RoaringRead64(const char* p){ return RoaringRead32(p) | ((uint64_t)RoaringRead32(p + 4) << 32); }
+
+int RoaringBitMapHasRun(const RoaringBitMap* rb){
+    for (const RoaringContainer& c : rb->_containers){
+        if (c._type == ROARING_RUN) return 1;
+    }
+    return 0;
+}
+
+size_t RoaringContainerSerializedSize(const RoaringContainer* c){
+    if (c->_type == ROARING_ARRAY) return 2 * (size_t)c->_card;
+    if (c->_type == ROARING_BITSET) return 8 * ROARING_BITSET_WORDS;
+    return 2 + 4 * c->_runs.size();
+}
+
+size_t RoaringBitMapSerializedSize(const RoaringBitMap* rb){
+    size_t n = rb->_containers.size();
+    int hasRun = RoaringBitMapHasRun(rb);
+    size_t bytes = hasRun ? 4 + (n + 7) / 8 : 8;
+    bytes += 4 * n;
+    if (!hasRun || n >= ROARING_NO_OFFSET_THRESHOLD) bytes += 4 * n;
+    for (const RoaringContainer& c : rb->_containers) bytes += RoaringContainerSerializedSize(&c);
+    return bytes;
+}
+
+// buf 至少 RoaringBitMapSerializedSize 字节，返回写入的字节数
+size_t RoaringBitMapSerialize(const RoaringBitMap* rb, char* buf){
+    assert(rb && buf);
+    size_t n = rb->_containers.size();
+    int hasRun = RoaringBitMapHasRun(rb);
+    char* p = buf;
+    if (hasRun){
+        RoaringWrite32(p, ROARING_SERIAL_COOKIE | ((uint32_t)(n - 1) << 16));
+        memset(p, 0, (n + 7) / 8);
+        for (size_t i = 0; i < n; i++){
+            if (rb->_containers[i]._type == ROARING_RUN) p[i / 8] |= (char)(1 << (i % 8));
+        }
+        p += (n + 7) / 8;
+    }
+    else{
+        RoaringWrite32(p, ROARING_SERIAL_COOKIE_NO_RUN);
+        RoaringWrite32(p, (uint32_t)n);
+    }
+    for (size_t i = 0; i < n; i++){
+        RoaringWrite16(p, rb->_keys[i]);
+        RoaringWrite16(p, (uint16_t)(rb->_containers[i]._card - 1));
+    }
+    if (!hasRun || n >= ROARING_NO_OFFSET_THRESHOLD){
+        uint32_t offset = (uint32_t)(p - buf + 4 * n);
+        for (size_t i = 0; i < n; i++){
+            RoaringWrite32(p, offset);
+            offset += (uint32_t)RoaringContainerSerializedSize(&rb->_containers[i]);
+        }
+    }
+    for (const RoaringContainer& c : rb->_containers){
+        if (c._type == ROARING_ARRAY){
+            for (uint16_t v : c._array) RoaringWrite16(p, v);
+        }
+        else if (c._type == ROARING_BITSET){
+            for (uint64_t w : c._bitset) RoaringWrite64(p, w);
+        }
+        else{
+            RoaringWrite16(p, (uint16_t)c._runs.size());
+            for (const RoaringRun& r : c._runs){
+                RoaringWrite16(p, r.start);
+                RoaringWrite16(p, r.length);
+            }
+        }
+    }
+    return p - buf;
+}
+
+// 成功返回0；数据被截断或格式不对返回-1
+int RoaringBitMapDeserialize(RoaringBitMap* rb, const char* buf, size_t len){
+    assert(rb && buf);
+    RoaringBitMapInit(rb);
+    const char* p = buf;
+    const char* end = buf + len;
+    if (len < 4) return -1;
+
+    uint32_t cookie = RoaringRead32(p);
+    p += 4;
+    size_t n;
+    const char* runFlags = NULL;
+    if ((cookie & 0xFFFF) == ROARING_SERIAL_COOKIE){
+        n = (cookie >> 16) + 1;
+        if ((size_t)(end - p) < (n + 7) / 8) return -1;
+        runFlags = p;
+        p += (n + 7) / 8;
+    }
+    else if (cookie == ROARING_SERIAL_COOKIE_NO_RUN){
+        if (end - p < 4) return -1;
+        n = RoaringRead32(p);
+        p += 4;
+        if (n > 65536) return -1;
+    }
+    else{
+        return -1;
+    }
+
+    if ((size_t)(end - p) < 4 * n) return -1;
+    const char* descriptions = p;
+    p += 4 * n;
+    if (!runFlags || n >= ROARING_NO_OFFSET_THRESHOLD){
+        if ((size_t)(end - p) < 4 * n) return -1;
+        p += 4 * n;     // 偏移只是方便随机访问，顺序读用不到
+    }
+
+    rb->_keys.resize(n);
+    rb->_containers.resize(n);
+    for (size_t i = 0; i < n; i++){
+        rb->_keys[i] = RoaringRead16(descriptions + 4 * i);
+        if (i > 0 && rb->_keys[i] <= rb->_keys[i - 1]) return -1;
+        uint32_t card = (uint32_t)RoaringRead16(descriptions + 4 * i + 2) + 1;
+        RoaringContainer& c = rb->_containers[i];
+        if (runFlags && ((uint8_t)runFlags[i / 8] >> (i % 8)) & 1){
+            if (end - p < 2) return -1;
+            size_t nruns = RoaringRead16(p);
+            p += 2;
+            if (nruns == 0 || (size_t)(end - p) < 4 * nruns) return -1;
+            c._type = ROARING_RUN;
+            c._card = 0;
+            c._runs.resize(nruns);
+            for (size_t r = 0; r < nruns; r++, p += 4){
+                c._runs[r].start = RoaringRead16(p);
+                c._runs[r].length = RoaringRead16(p + 2);
+                // 段不能越过 65535，且必须有序、互不重叠、互不相邻，否则后面按段写位图会越界
+                if ((uint32_t)c._runs[r].start + c._runs[r].length > 0xFFFF) return -1;
+                if (r > 0 && c._runs[r].start <= (uint32_t)c._runs[r - 1].start + c._runs[r - 1].length + 1) return -1;
+                c._card += (uint32_t)c._runs[r].length + 1;
+            }
+            if (c._card != card) return -1;
+        }
+        else if (card > ROARING_ARRAY_MAX){
+            if ((size_t)(end - p) < 8 * ROARING_BITSET_WORDS) return -1;
+            c._type = ROARING_BITSET;
+            c._bitset.resize(ROARING_BITSET_WORDS);
+            for (uint32_t w = 0; w < ROARING_BITSET_WORDS; w++, p += 8) c._bitset[w] = RoaringRead64(p);
+            c._card = RoaringBitsetCount(c._bitset.data());
+            if (c._card != card) return -1;
+        }
+        else{
+            if ((size_t)(end - p) < 2 * (size_t)card) return -1;
+            c._type = ROARING_ARRAY;
+            c._card = card;
+            c._array.resize(card);
+            for (uint32_t k = 0; k < card; k++, p += 2){
+                c._array[k] = RoaringRead16(p);
+                // Contains / Add 对数组做二分查找，必须严格递增
+                if (k > 0 && c._array[k] <= c._array[k - 1]) return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+
+void TestRoaringBitMap(){
+    // 2^32 空间里随机的 1 万个 ID：平铺的 BitMap 需要 2^27 个字
+    RoaringBitMap a, b;
+    RoaringBitMapInit(&a);
+    RoaringBitMapInit(&b);
+    vector<uint32_t> ids;
+    uint64_t seed = 88172645463325252ULL;
+    for (int i = 0; i < 10000; i++){
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        ids.push_back((uint32_t)seed);
+        RoaringBitMapSet(&a, (uint32_t)seed);
+    }
+    // b：一大段连续的 ID 加上 a 的前一半
+    for (uint32_t x = 1000000; x < 3000000; x++) RoaringBitMapSet(&b, x);
+    for (int i = 0; i < 5000; i++) RoaringBitMapSet(&b, ids[i]);
+    printf("a: card=%llu bytes=%zu (flat BitMap %zu bytes)\n", (unsigned long long)RoaringBitMapCardinality(&a),
+           RoaringBitMapBytes(&a), (((size_t)1 << 27) + 1) * sizeof(size_t));
+    size_t before = RoaringBitMapBytes(&b);
+    RoaringBitMapOptimize(&b);
+    printf("b: card=%llu bytes=%zu -> %zu after optimize\n", (unsigned long long)RoaringBitMapCardinality(&b),
+           before, RoaringBitMapBytes(&b));
+
+    int wrong = 0;
+    for (int i = 0; i < 10000; i++){
+        if (RoaringBitMapTest(&a, ids[i]) != 0) wrong++;
+    }
+    RoaringBitMap both = a;
+    RoaringBitMapAnd(&both, &b);
+    RoaringBitMap any = a;
+    RoaringBitMapOr(&any, &b);
+    printf("|a&b|=%llu |a|b|=%llu wrong=%d\n", (unsigned long long)RoaringBitMapCardinality(&both),
+           (unsigned long long)RoaringBitMapCardinality(&any), wrong);
+
+    // 序列化再读回来，内容应该完全一样
+    vector<char> buf(RoaringBitMapSerializedSize(&any));
+    size_t written = RoaringBitMapSerialize(&any, buf.data());
+    RoaringBitMap copy;
+    int ret = RoaringBitMapDeserialize(&copy, buf.data(), written);
+    vector<uint32_t> v1, v2;
+    RoaringBitMapToArray(&any, v1);
+    RoaringBitMapToArray(&copy, v2);
+    printf("serialized=%zu bytes deserialize=%d equal=%d\n", written, ret, (int)(v1 == v2));
+
+    // 格式不对的输入都要返回-1，不能留下越界的段或无序的数组
+    // 带行程标记的头：cookie 12347、1 个容器、行程标记字节；容器描述 (key=0, card-1)
+    const vector<vector<uint8_t>> malformed = {
+        {0x3B, 0x30, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0xFF, 0xFF, 0xFF, 0xFF},   // 段越过 65535
+        {0x3B, 0x30, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},                           // 0 个段
+        {0x3B, 0x30, 0x00, 0x00, 0x01, 0x00, 0x00, 0x06, 0x00, 0x02, 0x00,
+         0x0A, 0x00, 0x05, 0x00, 0x0C, 0x00, 0x00, 0x00},                                              // 段重叠
+        {0x3B, 0x30, 0x00, 0x00, 0x01, 0x00, 0x00, 0x06, 0x00, 0x02, 0x00,
+         0x0A, 0x00, 0x05, 0x00, 0x10, 0x00, 0x00, 0x00},                                              // 段相邻
+        {0x3B, 0x30, 0x00, 0x00, 0x01, 0x00, 0x00, 0x01, 0x00, 0x02, 0x00,
+         0x14, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x00},                                              // 段无序
+        {0x3B, 0x30, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x0A, 0x00, 0x05, 0x00},   // 段的基数和头不符
+        // 不带行程的头：cookie 12346、容器数、描述、偏移，然后是数组
+        {0x3A, 0x30, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+         0x10, 0x00, 0x00, 0x00, 0x05, 0x00, 0x05, 0x00},                                              // 数组有重复
+        {0x3A, 0x30, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+         0x10, 0x00, 0x00, 0x00, 0x07, 0x00, 0x05, 0x00},                                              // 数组无序
+    };
+    int rejected = 0;
+    for (const auto& bytes : malformed){
+        RoaringBitMap bad;
+        if (RoaringBitMapDeserialize(&bad, (const char*)bytes.data(), bytes.size()) == -1) rejected++;
+        RoaringBitMapDestroy(&bad);
+    }
+    // 合法的单段容器 [10, 15]，读回来以后并到非空位图里
+    const uint8_t validRun[] = {0x3B, 0x30, 0x00, 0x00, 0x01, 0x00, 0x00, 0x05, 0x00, 0x01, 0x00, 0x0A, 0x00, 0x05, 0x00};
+    RoaringBitMap run, merged = copy;
+    int runRet = RoaringBitMapDeserialize(&run, (const char*)validRun, sizeof(validRun));
+    RoaringBitMapOr(&merged, &run);
+    printf("malformed rejected=%d/%zu valid run deserialize=%d card=%llu\n", rejected, malformed.size(), runRet,
+           (unsigned long long)RoaringBitMapCardinality(&run));
+    RoaringBitMapDestroy(&run);
+    RoaringBitMapDestroy(&merged);
+
+    for (uint32_t x = 1500000; x < 1600000; x++) RoaringBitMapReset(&any, x);
+    printf("after reset: card=%llu test(1550000)=%d\n", (unsigned long long)RoaringBitMapCardinality(&any),
+           RoaringBitMapTest(&any, 1550000));
+
+    RoaringBitMapDestroy(&a);
+    RoaringBitMapDestroy(&b);
+    RoaringBitMapDestroy(&both);
+    RoaringBitMapDestroy(&any);
+    RoaringBitMapDestroy(&copy);
+}
+
+#endif //ALGORITHM_ADVANCED_ROARING_BITMAP_H
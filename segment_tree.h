@@ -17,10 +17,39 @@
 
 
 // 1. 我的日程安排表 III
-//
+// 2. 通用线段树模板 SegmentTree<T, Monoid, Lazy>（自底向上、非递归；支持区间赋值/区间加的懒标记）
+// 3. 树状数组 FenwickTree（O(n) 建树、区间加区间求和、按前缀和二分、二维）
+// 4. 动态开点线段树（连续结点池 + 标记永久化）与离线离散化，用于我的日程安排表 III
+// 5. 可持久化线段树（路径复制 + arena，按版本查区间和/第 k 小，旧版本 GC）
+// 6. 静态 RMQ：稀疏表、O(n) 空间的分块稀疏表（块内位掩码），O(1) 区间最小值/最大值
+// 7. 区间覆盖引擎 CoverageIndex（基数排序 + 扫描线 / SIMD 前缀和；是否覆盖、最大重叠、空隙，支持批量）
+// 8. 16 叉静态线段树 WideSegmentTree（一个结点一条 cache line，SIMD 更新，批量重建）
+// 9. 并发线段树 ConcurrentSegmentTree（排序后并行批量更新、逐层并行重建、left-right 快照读）
+// 10. 二维网格：FenwickTree2D 子矩形求和、树套树 SegmentTree2D 子矩形最大值，GridRangeQuery 批量查询
+// 11. 以组为单位订音乐会的门票 BookMyShow（结点同时存最大值和总和，线段树上二分找第一排）
+// 12. 积分排在第K位的猎头 HunterLeaderboard（ID 哈希索引 + 按子树大小计数的 treap，名次/第 K 名/分页）
 //
 #ifndef ALGORITHM_ADVANCED_SEGMENT_TREE_H
 #define ALGORITHM_ADVANCED_SEGMENT_TREE_H
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <limits>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+using namespace std;
 
 // 区域和检索 - 数组可修改
 class NumArray {
@@ -29,82 +58,2404 @@ private:
     int n;
 
     void build(int i, int l, int r, vector<int> &nums) {
-        if (l == e) {
+        if (l == r) {
             segmentTree[i] = nums[l];
             return;
         }
-        int m = l + (e - l) / 2;
-        build(i * 2 + 1, l, m, nums);
-        build(i * 2 + 2, m + 1, r, nums);
-        segmentTree[i] = segmentTree[i * 2 + 1] + segmentTree[i * 2 + 2];
+        int m = l + (r - l) / 2;
+        build(i * 2 + 1, l, m, nums);
+        build(i * 2 + 2, m + 1, r, nums);
+        segmentTree[i] = segmentTree[i * 2 + 1] + segmentTree[i * 2 + 2];
+    }
+
+    void change(int index, int val, int node, int s, int e) {
+        if (s == e) {
+            segmentTree[node] = val;
+            return;
+        }
+        int m = s + (e - s) / 2;
+        if (index <= m) {
+            change(index, val, node * 2 + 1, s, m);
+        } else {
+            change(index, val, node * 2 + 2, m + 1, e);
+        }
+        segmentTree[node] = segmentTree[node * 2 + 1] + segmentTree[node * 2 + 2];
+    }
+
+    int range(int left, int right, int node, int s, int e) {
+        if (left == s && right == e) {
+            return segmentTree[node];
+        }
+        int m = s + (e - s) / 2;
+        if (right <= m) {
+            return range(left, right, node * 2 + 1, s, m);
+        } else if (left > m) {
+            return range(left, right, node * 2 + 2, m + 1, e);
+        } else {
+            return range(left, m, node * 2 + 1, s, m) + range(m + 1, right, node * 2 + 2, m + 1, e);
+        }
+    }
+
+public:
+    NumArray(vector<int>& nums) : n(nums.size()), segmentTree(nums.size() * 4) {
+        build(0, 0, n - 1, nums);
+    }
+
+    void update(int index, int val) {
+        change(index, val, 0, 0, n - 1);
+    }
+
+    int sumRange(int left, int right) {
+        return range(left, right, 0, 0, n - 1);
+    }
+};
+
+
+//-----------------------------------------------------------------------------------
+//
+//          通用线段树模板 SegmentTree<T, Monoid, Lazy>
+//
+//-----------------------------------------------------------------------------------
+// NumArray 的问题：只能求 int 的和；递归实现，开 4n 的数组，每次修改/查询都是 O(log n) 层函数调用。
+// SegmentTree 的做法：
+//  (1) "怎么合并两个区间"抽成 Monoid（单位元 identity + 满足结合律的 op），求和、最小值、最大值都是 Monoid
+//  (2) 单点修改模式（Lazy = NoLazy）：2n 的数组，叶子放在 [n, 2n)，结点 i 的两个儿子是 2i 和 2i+1。
+//      修改从叶子往上走到根，查询从 l、r 两端往中间收，都是循环，没有递归；n 不需要是 2 的幂
+//  (3) 懒标记模式（Lazy = AssignAddLazy<T>）：支持区间赋值、区间加。叶子数补成 2 的幂 cap，
+//      先把 l、r 两条路径上的标记推下去，再自底向上给覆盖的结点打标记，最后沿两条路径重新合并
+//      （和 AtCoder Library 的 lazy_segtree 同一个写法）
+//  区间都是闭区间 [l, r]，和 NumArray::sumRange 一致。
+template<typename T>
+struct SumMonoid {
+    static T identity() { return T(); }
+    static T op(const T& a, const T& b) { return a + b; }
+    // len 个 x 合并起来的结果，懒标记作用到整个结点时要用
+    static T repeat(const T& x, size_t len) { return x * (T)len; }
+};
+
+template<typename T>
+struct MinMonoid {
+    static T identity() { return numeric_limits<T>::max(); }
+    static T op(const T& a, const T& b) { return min(a, b); }
+    static T repeat(const T& x, size_t) { return x; }
+};
+
+template<typename T>
+struct MaxMonoid {
+    static T identity() { return numeric_limits<T>::lowest(); }
+    static T op(const T& a, const T& b) { return max(a, b); }
+    static T repeat(const T& x, size_t) { return x; }
+};
+
+struct NoLazy {};
+
+// 区间赋值 + 区间加 的懒标记：作用时先赋值（如果有），再加
+template<typename T>
+struct AssignAddLazy {
+    struct Tag {
+        bool assign;
+        T value;
+        T add;
+    };
+    static Tag identity() { return Tag{false, T(), T()}; }
+    static Tag assignTag(const T& v) { return Tag{true, v, T()}; }
+    static Tag addTag(const T& v) { return Tag{false, T(), v}; }
+    static bool isIdentity(const Tag& f) { return !f.assign && f.add == T(); }
+    // 先作用 g 再作用 f，合成一个标记
+    static Tag compose(const Tag& f, const Tag& g) {
+        if (f.assign) return f;
+        return Tag{g.assign, g.value, g.add + f.add};
+    }
+    // 标记作用到一个覆盖 len 个元素、当前值为 x 的结点上。最小值/最大值整体加 v 还是加 v，和要加 v*len
+    template<typename Monoid>
+    static T apply(const Tag& f, const T& x, size_t len) {
+        T base = f.assign ? Monoid::repeat(f.value, len) : x;
+        return base + Monoid::repeat(f.add, len);
+    }
+};
+
+template<typename T, typename Monoid = SumMonoid<T>, typename Lazy = NoLazy>
+class SegmentTree;
+
+// 单点修改、区间查询
+template<typename T, typename Monoid>
+class SegmentTree<T, Monoid, NoLazy> {
+private:
+    size_t n;
+    vector<T> tree;     // tree[n + i] 是第 i 个元素，tree[i] = op(tree[2i], tree[2i+1])
+
+public:
+    explicit SegmentTree(size_t n) : n(n), tree(2 * n, Monoid::identity()) {}
+
+    explicit SegmentTree(const vector<T>& nums) : n(nums.size()), tree(2 * nums.size()) {
+        copy(nums.begin(), nums.end(), tree.begin() + n);
+        for (size_t i = n; i-- > 1; ) {
+            tree[i] = Monoid::op(tree[2 * i], tree[2 * i + 1]);
+        }
+    }
+
+    void update(size_t index, const T& val) {
+        size_t p = index + n;
+        tree[p] = val;
+        for (p >>= 1; p > 0; p >>= 1) {
+            tree[p] = Monoid::op(tree[2 * p], tree[2 * p + 1]);
+        }
+    }
+
+    // [left, right] 的合并结果。左右两边分开累积，op 不满足交换律也没问题
+    T query(size_t left, size_t right) const {
+        T resl = Monoid::identity(), resr = Monoid::identity();
+        for (size_t l = left + n, r = right + n + 1; l < r; l >>= 1, r >>= 1) {
+            if (l & 1) resl = Monoid::op(resl, tree[l++]);
+            if (r & 1) resr = Monoid::op(tree[--r], resr);
+        }
+        return Monoid::op(resl, resr);
+    }
+
+    T get(size_t index) const {
+        return tree[index + n];
+    }
+
+    size_t size() const {
+        return n;
+    }
+};
+
+// 区间修改（赋值/加）、区间查询
+template<typename T, typename Monoid, typename Lazy>
+class SegmentTree {
+private:
+    typedef typename Lazy::Tag Tag;
+    size_t n;
+    size_t cap;         // 叶子数，>= n 的最小的 2 的幂
+    int levels;         // cap = 2^levels
+    vector<T> tree;     // tree[cap + i] 是第 i 个元素
+    vector<Tag> lazy;   // 内部结点上还没推给儿子的标记
+
+    // 高度为 height 的结点覆盖 2^height 个叶子
+    void applyNode(size_t p, const Tag& f, int height) {
+        tree[p] = Lazy::template apply<Monoid>(f, tree[p], (size_t)1 << height);
+        if (p < cap) lazy[p] = Lazy::compose(f, lazy[p]);
+    }
+
+    // 没有标记就不碰两个儿子，查询路径上大部分结点都是这种情况，省掉一半的内存写
+    void push(size_t p, int height) {
+        if (Lazy::isIdentity(lazy[p])) return;
+        applyNode(2 * p, lazy[p], height - 1);
+        applyNode(2 * p + 1, lazy[p], height - 1);
+        lazy[p] = Lazy::identity();
+    }
+
+    void pull(size_t p) {
+        tree[p] = Monoid::op(tree[2 * p], tree[2 * p + 1]);
+    }
+
+    // 把 [l, r) 两个端点所在路径上的标记全部推下去（l、r 已经加上 cap）
+    void pushBoundary(size_t l, size_t r) {
+        for (int i = levels; i >= 1; i--) {
+            if (((l >> i) << i) != l) push(l >> i, i);
+            if (((r >> i) << i) != r) push((r - 1) >> i, i);
+        }
+    }
+
+public:
+    explicit SegmentTree(size_t n) : SegmentTree(vector<T>(n, T())) {}
+
+    explicit SegmentTree(const vector<T>& nums) : n(nums.size()), cap(1), levels(0) {
+        while (cap < n) {
+            cap <<= 1;
+            levels++;
+        }
+        tree.assign(2 * cap, Monoid::identity());
+        lazy.assign(cap, Lazy::identity());
+        copy(nums.begin(), nums.end(), tree.begin() + cap);
+        for (size_t i = cap; i-- > 1; ) {
+            pull(i);
+        }
+    }
+
+    void rangeApply(size_t left, size_t right, const Tag& f) {
+        size_t l = left + cap, r = right + cap + 1;
+        pushBoundary(l, r);
+        for (size_t l2 = l, r2 = r, height = 0; l2 < r2; l2 >>= 1, r2 >>= 1, height++) {
+            if (l2 & 1) applyNode(l2++, f, (int)height);
+            if (r2 & 1) applyNode(--r2, f, (int)height);
+        }
+        for (int i = 1; i <= levels; i++) {
+            if (((l >> i) << i) != l) pull(l >> i);
+            if (((r >> i) << i) != r) pull((r - 1) >> i);
+        }
+    }
+
+    void rangeAdd(size_t left, size_t right, const T& val) {
+        rangeApply(left, right, Lazy::addTag(val));
+    }
+
+    void rangeAssign(size_t left, size_t right, const T& val) {
+        rangeApply(left, right, Lazy::assignTag(val));
+    }
+
+    void update(size_t index, const T& val) {
+        rangeAssign(index, index, val);
+    }
+
+    T query(size_t left, size_t right) {
+        size_t l = left + cap, r = right + cap + 1;
+        pushBoundary(l, r);
+        T resl = Monoid::identity(), resr = Monoid::identity();
+        for (; l < r; l >>= 1, r >>= 1) {
+            if (l & 1) resl = Monoid::op(resl, tree[l++]);
+            if (r & 1) resr = Monoid::op(tree[--r], resr);
+        }
+        return Monoid::op(resl, resr);
+    }
+
+    T get(size_t index) {
+        return query(index, index);
+    }
+
+    size_t size() const {
+        return n;
+    }
+};
+
+void TestSegmentTree() {
+    mt19937 rng(7);
+    const int n = 1000;
+    vector<long long> ref(n);
+    for (auto& x : ref) x = rng() % 1000;
+    SegmentTree<long long, SumMonoid<long long>, AssignAddLazy<long long>> sum(ref);
+    SegmentTree<long long, MinMonoid<long long>, AssignAddLazy<long long>> mn(ref);
+    SegmentTree<long long, MaxMonoid<long long>, AssignAddLazy<long long>> mx(ref);
+    SegmentTree<long long, MinMonoid<long long>> pointMin(ref);
+
+    int wrong = 0;
+    for (int t = 0; t < 100000; t++) {
+        int l = rng() % n, r = rng() % n;
+        if (l > r) swap(l, r);
+        long long v = (long long)(rng() % 2001) - 1000;
+        switch (rng() % 4) {
+            case 0:
+                for (int i = l; i <= r; i++) pointMin.update(i, ref[i] += v);
+                sum.rangeAdd(l, r, v);
+                mn.rangeAdd(l, r, v);
+                mx.rangeAdd(l, r, v);
+                break;
+            case 1:
+                for (int i = l; i <= r; i++) pointMin.update(i, ref[i] = v);
+                sum.rangeAssign(l, r, v);
+                mn.rangeAssign(l, r, v);
+                mx.rangeAssign(l, r, v);
+                break;
+            case 2:
+                pointMin.update(l, ref[l] = v);
+                sum.update(l, v);
+                mn.update(l, v);
+                mx.update(l, v);
+                break;
+            default: {
+                long long s = 0, lo = ref[l], hi = ref[l];
+                for (int i = l; i <= r; i++) {
+                    s += ref[i];
+                    lo = min(lo, ref[i]);
+                    hi = max(hi, ref[i]);
+                }
+                if (sum.query(l, r) != s || mn.query(l, r) != lo || mx.query(l, r) != hi) wrong++;
+            }
+        }
+        if (pointMin.query(l, r) != *min_element(ref.begin() + l, ref.begin() + r + 1)) wrong++;
+    }
+    printf("TestSegmentTree wrong=%d\n", wrong);
+}
+
+//-----------------------------------------------------------------------------------
+//
+//          树状数组 FenwickTree<T>
+//
+//-----------------------------------------------------------------------------------
+// 单点修改、区间求和只需要树状数组：n + 1 个元素（NumArray 要 4n 个），修改和查询都是一个 i += lowbit(i) 的循环。
+//  - tree[i] 保存 (i - lowbit(i), i] 这一段的和（下标从 1 开始，对外的接口仍然从 0 开始）
+//  - O(n) 建树：先把原数组拷进去，每个 tree[i] 只往它的父亲 i + lowbit(i) 加一次
+//  - lowerBound：元素都非负时前缀和单调，从最高位往下倍增，O(log n) 找到前缀和第一次 >= target 的位置（第 k 小）
+//  - RangeFenwickTree：两个树状数组维护差分 d[i] 和 d[i] * i，支持区间加、区间求和
+//      a[0] + ... + a[k-1] = k * sum(d[0..k-1]) - sum(d[i] * i, i < k)
+//  - FenwickTree2D：二维的树状数组，行优先存在一块连续内存里，子矩阵求和
+template<typename T>
+class FenwickTree {
+private:
+    size_t n;
+    vector<T> tree;
+
+    static size_t lowbit(size_t i) { return i & (~i + 1); }
+
+public:
+    explicit FenwickTree(size_t n) : n(n), tree(n + 1, T()) {}
+
+    explicit FenwickTree(const vector<T>& nums) : n(nums.size()), tree(nums.size() + 1, T()) {
+        for (size_t i = 1; i <= n; i++) {
+            tree[i] += nums[i - 1];
+            size_t parent = i + lowbit(i);
+            if (parent <= n) tree[parent] += tree[i];
+        }
+    }
+
+    void add(size_t index, const T& delta) {
+        for (size_t i = index + 1; i <= n; i += lowbit(i)) {
+            tree[i] += delta;
+        }
+    }
+
+    // 前 count 个元素的和，即 [0, count)
+    T prefixSum(size_t count) const {
+        T sum = T();
+        for (size_t i = count; i > 0; i -= lowbit(i)) {
+            sum += tree[i];
+        }
+        return sum;
+    }
+
+    T rangeSum(size_t left, size_t right) const {
+        return prefixSum(right + 1) - prefixSum(left);
+    }
+
+    // 单个元素：tree[i] 减去 (i - lowbit(i), i) 里那些结点，比两次 prefixSum 少走一半
+    T get(size_t index) const {
+        size_t i = index + 1, stop = i - lowbit(i);
+        T val = tree[i];
+        for (size_t j = i - 1; j > stop; j -= lowbit(j)) {
+            val -= tree[j];
+        }
+        return val;
+    }
+
+    void set(size_t index, const T& val) {
+        add(index, val - get(index));
+    }
+
+    // 元素都非负时，返回前缀和 a[0] + ... + a[i] >= target 的最小的 i；都不满足返回 n
+    size_t lowerBound(T target) const {
+        size_t pos = 0, step = 1;
+        while (step * 2 <= n) step *= 2;
+        for (; step > 0; step >>= 1) {
+            if (pos + step <= n && tree[pos + step] < target) {
+                pos += step;
+                target -= tree[pos];
+            }
+        }
+        return pos;
+    }
+
+    size_t size() const {
+        return n;
+    }
+};
+
+// 区间加、区间求和
+template<typename T>
+class RangeFenwickTree {
+private:
+    FenwickTree<T> d;       // 差分 d[i] = a[i] - a[i-1]
+    FenwickTree<T> di;      // d[i] * i
+
+    static vector<T> diff(const vector<T>& nums, bool weighted) {
+        vector<T> res(nums.size());
+        for (size_t i = 0; i < nums.size(); i++) {
+            res[i] = i == 0 ? nums[0] : nums[i] - nums[i - 1];
+            if (weighted) res[i] *= (T)i;
+        }
+        return res;
+    }
+
+    void addSuffix(size_t index, const T& delta) {
+        if (index >= d.size()) return;
+        d.add(index, delta);
+        di.add(index, delta * (T)index);
+    }
+
+public:
+    explicit RangeFenwickTree(size_t n) : d(n), di(n) {}
+
+    explicit RangeFenwickTree(const vector<T>& nums) : d(diff(nums, false)), di(diff(nums, true)) {}
+
+    void rangeAdd(size_t left, size_t right, const T& delta) {
+        addSuffix(left, delta);
+        addSuffix(right + 1, -delta);
+    }
+
+    // 前 count 个元素的和
+    T prefixSum(size_t count) const {
+        return d.prefixSum(count) * (T)count - di.prefixSum(count);
+    }
+
+    T rangeSum(size_t left, size_t right) const {
+        return prefixSum(right + 1) - prefixSum(left);
+    }
+
+    size_t size() const {
+        return d.size();
+    }
+};
+
+// 二维：单点加、子矩阵求和
+template<typename T>
+class FenwickTree2D {
+private:
+    size_t rows, cols;
+    vector<T> tree;     // (rows + 1) * (cols + 1)，行优先
+
+    static size_t lowbit(size_t i) { return i & (~i + 1); }
+    T& at(size_t i, size_t j) { return tree[i * (cols + 1) + j]; }
+
+public:
+    FenwickTree2D(size_t rows, size_t cols) : rows(rows), cols(cols), tree((rows + 1) * (cols + 1), T()) {}
+
+    // grid 是 rows * cols 的行优先数组；先在每一行内建树，再把每一行加到父亲行上，O(rows * cols)
+    FenwickTree2D(const vector<T>& grid, size_t rows, size_t cols)
+        : rows(rows), cols(cols), tree((rows + 1) * (cols + 1), T()) {
+        assert(grid.size() == rows * cols);
+        for (size_t i = 1; i <= rows; i++) {
+            copy(grid.begin() + (i - 1) * cols, grid.begin() + i * cols, tree.begin() + i * (cols + 1) + 1);
+            for (size_t j = 1; j <= cols; j++) {
+                size_t parent = j + lowbit(j);
+                if (parent <= cols) at(i, parent) += at(i, j);
+            }
+        }
+        for (size_t i = 1; i <= rows; i++) {
+            size_t parent = i + lowbit(i);
+            if (parent > rows) continue;
+            for (size_t j = 1; j <= cols; j++) {
+                at(parent, j) += at(i, j);
+            }
+        }
+    }
+
+    void add(size_t row, size_t col, const T& delta) {
+        for (size_t i = row + 1; i <= rows; i += lowbit(i)) {
+            for (size_t j = col + 1; j <= cols; j += lowbit(j)) {
+                at(i, j) += delta;
+            }
+        }
+    }
+
+    // 左上角 rowCount * colCount 的子矩阵的和
+    T prefixSum(size_t rowCount, size_t colCount) const {
+        T sum = T();
+        for (size_t i = rowCount; i > 0; i -= lowbit(i)) {
+            const T* line = &tree[i * (cols + 1)];
+            for (size_t j = colCount; j > 0; j -= lowbit(j)) {
+                sum += line[j];
+            }
+        }
+        return sum;
+    }
+
+    // 第 i 行上 列前缀(a) - 列前缀(b)。两条 lowbit 链走到相同的位置之后就互相抵消了，不用各自走到 0
+    T rowDiff(size_t i, size_t a, size_t b) const {
+        const T* line = &tree[i * (cols + 1)];
+        T sum = T();
+        while (a != b) {
+            if (a > b) {
+                sum += line[a];
+                a -= lowbit(a);
+            } else {
+                sum -= line[b];
+                b -= lowbit(b);
+            }
+        }
+        return sum;
+    }
+
+    // 闭区间 [row1, row2] x [col1, col2]。行方向同样只走两条链不重合的部分，小矩形只访问很少的几行
+    T rectSum(size_t row1, size_t col1, size_t row2, size_t col2) const {
+        size_t a = row2 + 1, b = row1;
+        T sum = T();
+        while (a != b) {
+            if (a > b) {
+                sum += rowDiff(a, col2 + 1, col1);
+                a -= lowbit(a);
+            } else {
+                sum -= rowDiff(b, col2 + 1, col1);
+                b -= lowbit(b);
+            }
+        }
+        return sum;
+    }
+};
+
+void TestFenwickTree() {
+    mt19937 rng(16);
+    const int n = 1000;
+    vector<long long> ref(n);
+    for (auto& x : ref) x = rng() % 100;
+    FenwickTree<long long> bit(ref);
+    RangeFenwickTree<long long> range(ref);
+
+    int wrong = 0;
+    for (int t = 0; t < 100000; t++) {
+        int l = rng() % n, r = rng() % n;
+        if (l > r) swap(l, r);
+        long long v = rng() % 100;
+        switch (rng() % 3) {
+            case 0:
+                range.rangeAdd(l, r, v);
+                for (int i = l; i <= r; i++) {
+                    ref[i] += v;
+                    bit.add(i, v);
+                }
+                break;
+            case 1:
+                range.rangeAdd(l, l, v - ref[l]);
+                ref[l] = v;
+                bit.set(l, v);
+                break;
+            default: {
+                long long s = 0;
+                for (int i = l; i <= r; i++) s += ref[i];
+                if (bit.rangeSum(l, r) != s || range.rangeSum(l, r) != s || bit.get(l) != ref[l]) wrong++;
+                long long target = rng() % (bit.prefixSum(n) + 2);
+                size_t k = 0;
+                long long prefix = 0;
+                while (k < (size_t)n && prefix + ref[k] < target) prefix += ref[k++];
+                if (bit.lowerBound(target) != k) wrong++;
+            }
+        }
+    }
+
+    const size_t rows = 37, cols = 53;
+    vector<long long> grid(rows * cols);
+    for (auto& x : grid) x = rng() % 100;
+    FenwickTree2D<long long> bit2(grid, rows, cols);
+    for (int t = 0; t < 10000; t++) {
+        size_t r1 = rng() % rows, r2 = rng() % rows, c1 = rng() % cols, c2 = rng() % cols;
+        if (r1 > r2) swap(r1, r2);
+        if (c1 > c2) swap(c1, c2);
+        if (t & 1) {
+            long long v = rng() % 100;
+            grid[r1 * cols + c1] += v;
+            bit2.add(r1, c1, v);
+        } else {
+            long long s = 0;
+            for (size_t i = r1; i <= r2; i++) {
+                for (size_t j = c1; j <= c2; j++) s += grid[i * cols + j];
+            }
+            if (bit2.rectSum(r1, c1, r2, c2) != s) wrong++;
+        }
+    }
+    printf("TestFenwickTree wrong=%d\n", wrong);
+}
+
+// 线段树/树状数组性能对比：n 个元素，ops 次操作，一半单点修改、一半区间求和
+struct SegmentTreeBenchOp {
+    bool isUpdate;
+    int l;
+    int r;      // isUpdate 时是新的值
+};
+
+template<typename Update, typename Query>
+void SegmentTreeBenchRun(const char* name, double buildMs, size_t bytes,
+                         const vector<SegmentTreeBenchOp>& ops, Update update, Query query) {
+    long long checksum = 0;
+    auto t0 = chrono::steady_clock::now();
+    for (const SegmentTreeBenchOp& op : ops) {
+        if (op.isUpdate) update(op.l, op.r);
+        else checksum += query(op.l, op.r);
+    }
+    auto t1 = chrono::steady_clock::now();
+    printf("%-26s build=%7.1fms memory=%5zuMB ops=%6.1fns/op checksum=%lld\n", name, buildMs, bytes >> 20,
+           chrono::duration<double, nano>(t1 - t0).count() / ops.size(), checksum);
+}
+
+void BenchSegmentTree(size_t n = 10000000, size_t nops = 10000000) {
+    mt19937 rng(2022);
+    vector<int> nums(n);
+    for (auto& x : nums) x = rng() % 100;   // 总和不超过 10^9，NumArray 的 int 不会溢出
+    vector<SegmentTreeBenchOp> ops(nops);
+    for (auto& op : ops) {
+        op.isUpdate = rng() & 1;
+        op.l = rng() % n;
+        op.r = op.isUpdate ? (int)(rng() % 100) : (int)(rng() % n);
+        if (!op.isUpdate && op.l > op.r) swap(op.l, op.r);
+    }
+
+    auto t0 = chrono::steady_clock::now();
+    {
+        NumArray recursive(nums);
+        auto t1 = chrono::steady_clock::now();
+        SegmentTreeBenchRun("NumArray (recursive, 4n)", chrono::duration<double, milli>(t1 - t0).count(),
+                            4 * n * sizeof(int), ops,
+                            [&](int i, int v) { recursive.update(i, v); },
+                            [&](int l, int r) { return recursive.sumRange(l, r); });
+    }
+
+    t0 = chrono::steady_clock::now();
+    {
+        SegmentTree<int> iterative(nums);
+        auto t1 = chrono::steady_clock::now();
+        SegmentTreeBenchRun("SegmentTree (2n)", chrono::duration<double, milli>(t1 - t0).count(),
+                            2 * n * sizeof(int), ops,
+                            [&](int i, int v) { iterative.update(i, v); },
+                            [&](int l, int r) { return iterative.query(l, r); });
+    }
+
+    t0 = chrono::steady_clock::now();
+    {
+        vector<long long> wide(nums.begin(), nums.end());
+        SegmentTree<long long, SumMonoid<long long>, AssignAddLazy<long long>> lazyTree(wide);
+        auto t1 = chrono::steady_clock::now();
+        size_t cap = 1;
+        while (cap < n) cap <<= 1;
+        SegmentTreeBenchRun("SegmentTree (lazy)", chrono::duration<double, milli>(t1 - t0).count(),
+                            2 * cap * sizeof(long long) + cap * sizeof(AssignAddLazy<long long>::Tag), ops,
+                            [&](int i, int v) { lazyTree.update(i, v); },
+                            [&](int l, int r) { return lazyTree.query(l, r); });
+    }
+
+    t0 = chrono::steady_clock::now();
+    {
+        FenwickTree<int> fenwick(nums);
+        auto t1 = chrono::steady_clock::now();
+        SegmentTreeBenchRun("FenwickTree", chrono::duration<double, milli>(t1 - t0).count(),
+                            (n + 1) * sizeof(int), ops,
+                            [&](int i, int v) { fenwick.set(i, v); },
+                            [&](int l, int r) { return fenwick.rangeSum(l, r); });
+    }
+
+    t0 = chrono::steady_clock::now();
+    {
+        vector<long long> wide(nums.begin(), nums.end());
+        RangeFenwickTree<long long> rangeFenwick(wide);
+        auto t1 = chrono::steady_clock::now();
+        SegmentTreeBenchRun("RangeFenwickTree", chrono::duration<double, milli>(t1 - t0).count(),
+                            2 * (n + 1) * sizeof(long long), ops,
+                            [&](int i, int v) { rangeFenwick.rangeAdd(i, i, v - rangeFenwick.rangeSum(i, i)); },
+                            [&](int l, int r) { return rangeFenwick.rangeSum(l, r); });
+    }
+}
+
+
+//-----------------------------------------------------------------------------------
+//
+//          可持久化线段树（主席树）- 按版本查询历史数据
+//
+//-----------------------------------------------------------------------------------
+// 每个版本保存一份 NumArray 太贵了：n 个元素每个版本都要 O(n) 的空间。
+// 可持久化线段树的做法（路径复制）：
+//  (1) 单点修改只会改变根到叶子这一条路径上的 log n 个结点，只复制这些结点，其余子树和旧版本共用
+//  (2) 每个版本只记一个根；旧版本的根一直可以查询，区间和和第 k 小都是 O(log n)
+//  (3) 结点放在一个连续的 vector（arena）里，儿子是 32 位下标，0 号是空结点（和为 0，两个儿子都指向自己），
+//      全 0 的初始版本就是 0 号结点，不占空间
+//  (4) 第 k 小：把数组看成"值 -> 出现次数"的计数数组，按左子树的和往下走，O(log n)；
+//      用两个版本的差，可以求"版本 older 之后新插入的那些数"里的第 k 小（经典的区间第 k 小）
+//  (5) 垃圾回收 compact(watermark)：丢掉比 watermark 旧的版本，从剩下的根出发把还能访问到的结点
+//      按先序复制到新的 arena（复制式 GC），共享的子树只复制一次，复制之后同一个版本的结点在内存里也更集中
+class PersistentSegmentTree {
+private:
+    struct Node {
+        long long sum;
+        uint32_t left;
+        uint32_t right;
+    };
+    size_t n;
+    vector<Node> pool;          // pool[0] 是空结点
+    vector<uint32_t> roots;     // roots[v - firstVersion] 是版本 v 的根
+    size_t firstVersion;        // compact 之后最旧的还保留着的版本号
+
+    uint32_t newNode(const Node& node) {
+        assert(pool.size() < numeric_limits<uint32_t>::max());
+        pool.push_back(node);
+        return (uint32_t)(pool.size() - 1);
+    }
+
+    uint32_t build(size_t l, size_t r, const vector<long long>& nums) {
+        if (l == r) {
+            return newNode(Node{nums[l], 0, 0});
+        }
+        size_t m = l + (r - l) / 2;
+        uint32_t left = build(l, m, nums);
+        uint32_t right = build(m + 1, r, nums);
+        return newNode(Node{pool[left].sum + pool[right].sum, left, right});
+    }
+
+    // 复制 prev 到 index 的路径，返回新的结点
+    uint32_t update(uint32_t prev, size_t l, size_t r, size_t index, long long delta) {
+        Node copy = pool[prev];     // 先拷出来，newNode 可能让 pool 扩容
+        copy.sum += delta;
+        uint32_t cur = newNode(copy);
+        if (l == r) {
+            return cur;
+        }
+        size_t m = l + (r - l) / 2;
+        if (index <= m) {
+            uint32_t child = update(copy.left, l, m, index, delta);
+            pool[cur].left = child;
+        } else {
+            uint32_t child = update(copy.right, m + 1, r, index, delta);
+            pool[cur].right = child;
+        }
+        return cur;
+    }
+
+    long long query(uint32_t p, size_t l, size_t r, size_t ql, size_t qr) const {
+        if (p == 0) return 0;
+        if (ql <= l && r <= qr) return pool[p].sum;
+        size_t m = l + (r - l) / 2;
+        long long sum = 0;
+        if (ql <= m) sum += query(pool[p].left, l, m, ql, qr);
+        if (qr > m) sum += query(pool[p].right, m + 1, r, ql, qr);
+        return sum;
+    }
+
+    uint32_t relocate(uint32_t p, vector<Node>& fresh, vector<uint32_t>& forward) const {
+        if (forward[p] != numeric_limits<uint32_t>::max()) {
+            return forward[p];
+        }
+        uint32_t q = (uint32_t)fresh.size();
+        fresh.push_back(pool[p]);
+        forward[p] = q;
+        uint32_t left = relocate(pool[p].left, fresh, forward);
+        uint32_t right = relocate(pool[p].right, fresh, forward);
+        fresh[q].left = left;
+        fresh[q].right = right;
+        return q;
+    }
+
+    uint32_t rootOf(size_t version) const {
+        assert(version >= firstVersion && version - firstVersion < roots.size());
+        return roots[version - firstVersion];
+    }
+
+public:
+    // 版本 0：n 个 0
+    explicit PersistentSegmentTree(size_t n) : n(n), firstVersion(0) {
+        assert(n > 0);
+        pool.push_back(Node{0, 0, 0});
+        roots.push_back(0);
+    }
+
+    // 版本 0：nums
+    explicit PersistentSegmentTree(const vector<long long>& nums) : n(nums.size()), firstVersion(0) {
+        assert(n > 0);
+        pool.reserve(2 * n);
+        pool.push_back(Node{0, 0, 0});
+        roots.push_back(build(0, n - 1, nums));
+    }
+
+    // 在最新版本上把 nums[index] 加 delta，生成一个新版本，返回新版本号
+    size_t add(size_t index, long long delta) {
+        roots.push_back(update(roots.back(), 0, n - 1, index, delta));
+        return latestVersion();
+    }
+
+    size_t set(size_t index, long long val) {
+        return add(index, val - rangeSum(latestVersion(), index, index));
+    }
+
+    long long rangeSum(size_t version, size_t left, size_t right) const {
+        return query(rootOf(version), 0, n - 1, left, right);
+    }
+
+    // 版本 version 里，前缀和 >= k 的最小下标（元素非负，当成计数数组就是第 k 小的值，k 从 1 开始）；不存在返回 n
+    size_t kth(size_t version, long long k) const {
+        uint32_t p = rootOf(version);
+        if (k <= 0 || pool[p].sum < k) return n;
+        size_t l = 0, r = n - 1;
+        while (l < r) {
+            size_t m = l + (r - l) / 2;
+            long long leftSum = pool[pool[p].left].sum;
+            if (k <= leftSum) {
+                p = pool[p].left;
+                r = m;
+            } else {
+                k -= leftSum;
+                p = pool[p].right;
+                l = m + 1;
+            }
+        }
+        return l;
+    }
+
+    // 版本 newer 减去版本 older 之后的第 k 小：比如第 i 个版本插入 a[i-1]，
+    //  kth(l, r + 1, k) 就是 a[l..r] 里的第 k 小
+    size_t kth(size_t older, size_t newer, long long k) const {
+        uint32_t p = rootOf(older), q = rootOf(newer);
+        if (k <= 0 || pool[q].sum - pool[p].sum < k) return n;
+        size_t l = 0, r = n - 1;
+        while (l < r) {
+            size_t m = l + (r - l) / 2;
+            long long leftSum = pool[pool[q].left].sum - pool[pool[p].left].sum;
+            if (k <= leftSum) {
+                p = pool[p].left;
+                q = pool[q].left;
+                r = m;
+            } else {
+                k -= leftSum;
+                p = pool[p].right;
+                q = pool[q].right;
+                l = m + 1;
+            }
+        }
+        return l;
+    }
+
+    size_t oldestVersion() const {
+        return firstVersion;
+    }
+
+    size_t latestVersion() const {
+        return firstVersion + roots.size() - 1;
+    }
+
+    size_t nodeCount() const {
+        return pool.size() - 1;
+    }
+
+    // 丢掉所有比 watermark 旧的版本（最新版本总是保留），压缩 arena，返回回收的结点数
+    size_t compact(size_t watermark) {
+        watermark = min(watermark, latestVersion());
+        if (watermark <= firstVersion) {
+            return 0;
+        }
+        roots.erase(roots.begin(), roots.begin() + (watermark - firstVersion));
+        firstVersion = watermark;
+
+        vector<uint32_t> forward(pool.size(), numeric_limits<uint32_t>::max());
+        forward[0] = 0;
+        vector<Node> fresh;
+        fresh.push_back(Node{0, 0, 0});
+        for (uint32_t& root : roots) {
+            root = relocate(root, fresh, forward);
+        }
+        size_t freed = pool.size() - fresh.size();
+        fresh.shrink_to_fit();
+        pool.swap(fresh);
+        return freed;
+    }
+};
+
+void TestPersistentSegmentTree() {
+    mt19937 rng(18);
+    const size_t n = 200;
+    vector<long long> cur(n);
+    for (auto& x : cur) x = rng() % 5;
+    PersistentSegmentTree tree(cur);
+    vector<vector<long long>> history = {cur};
+
+    int wrong = 0;
+    for (int t = 0; t < 2000; t++) {
+        size_t i = rng() % n;
+        long long delta = rng() % 5;
+        cur[i] += delta;
+        if (tree.add(i, delta) != history.size()) wrong++;
+        history.push_back(cur);
+    }
+    auto check = [&]() {
+        for (int t = 0; t < 2000; t++) {
+            size_t v = tree.oldestVersion() + rng() % (tree.latestVersion() - tree.oldestVersion() + 1);
+            size_t l = rng() % n, r = rng() % n;
+            if (l > r) swap(l, r);
+            const vector<long long>& a = history[v];
+            long long s = 0, total = 0;
+            for (size_t j = l; j <= r; j++) s += a[j];
+            for (long long x : a) total += x;
+            if (tree.rangeSum(v, l, r) != s) wrong++;
+            long long k = 1 + rng() % (total + 1);
+            size_t expect = 0;
+            for (long long prefix = 0; expect < n; expect++) {
+                prefix += a[expect];
+                if (prefix >= k) break;
+            }
+            if (tree.kth(v, k) != expect) wrong++;
+            // 两个版本之差：版本 v 相对 older 的增量
+            size_t older = tree.oldestVersion() + rng() % (v - tree.oldestVersion() + 1);
+            long long diffTotal = total;
+            for (long long x : history[older]) diffTotal -= x;
+            long long kd = 1 + rng() % (diffTotal + 1);
+            size_t expectDiff = 0;
+            long long prefix = 0;
+            for (; expectDiff < n; expectDiff++) {
+                prefix += a[expectDiff] - history[older][expectDiff];
+                if (prefix >= kd) break;
+            }
+            if (tree.kth(older, v, kd) != expectDiff) wrong++;
+        }
+    };
+    check();
+    size_t before = tree.nodeCount();
+    size_t freed = tree.compact(1500);
+    check();
+    printf("TestPersistentSegmentTree wrong=%d nodes %zu -> %zu (freed %zu) versions [%zu, %zu]\n", wrong, before,
+           tree.nodeCount(), freed, tree.oldestVersion(), tree.latestVersion());
+}
+
+// n 个指标，连续 updates 次单点修改：每次修改的耗时、历史版本查询的耗时、GC 的耗时和回收量
+void BenchPersistentSegmentTree(size_t n = 1000000, size_t updates = 2000000) {
+    mt19937 rng(2018);
+    vector<long long> nums(n);
+    for (auto& x : nums) x = rng() % 100;
+
+    PersistentSegmentTree tree(nums);
+    auto t0 = chrono::steady_clock::now();
+    for (size_t i = 0; i < updates; i++) {
+        tree.add(rng() % n, (long long)(rng() % 100));
+    }
+    auto t1 = chrono::steady_clock::now();
+    long long checksum = 0;
+    const size_t queries = 1000000;
+    for (size_t i = 0; i < queries; i++) {
+        size_t v = rng() % (tree.latestVersion() + 1);
+        size_t l = rng() % n, r = rng() % n;
+        if (l > r) swap(l, r);
+        checksum += tree.rangeSum(v, l, r);
+        checksum += tree.kth(v, 1 + rng() % 1000000);
+    }
+    auto t2 = chrono::steady_clock::now();
+    size_t nodes = tree.nodeCount();
+    size_t freed = tree.compact(updates / 2);
+    auto t3 = chrono::steady_clock::now();
+    printf("update=%.1fns query(sum+kth)=%.1fns arena=%zuMB (a copy of NumArray per version would be %zuGB) "
+           "compact(half)=%.1fms freed=%zu/%zu nodes checksum=%lld\n",
+           chrono::duration<double, nano>(t1 - t0).count() / updates,
+           chrono::duration<double, nano>(t2 - t1).count() / queries, nodes * 16 >> 20,
+           (updates * 4 * n * sizeof(int)) >> 30, chrono::duration<double, milli>(t3 - t2).count(), freed, nodes, checksum);
+}
+
+
+//-----------------------------------------------------------------------------------
+//
+//          静态 RMQ - 稀疏表与 O(n) 空间的分块稀疏表
+//
+//-----------------------------------------------------------------------------------
+// 数组不再修改时，区间最小值/最大值不需要线段树的 O(log n)：
+//  SparseTable：table[k][i] = [i, i + 2^k) 的最值，所有行连续放在一个数组里。
+//      查询 [l, r] 取 k = floor(log2(r - l + 1))，两段 [l, l + 2^k) 和 (r - 2^k, r] 重叠覆盖整个区间，O(1)。
+//      代价是 n log n 的空间，n = 10^8 时要 27 行，放不下
+//  BlockRMQ：每 64 个元素一块，O(n) 空间，查询仍然 O(1)：
+//      (1) 块间：每块的最值组成一个长度 n/64 的数组，在上面建稀疏表，只有 n/64 * log 个元素
+//      (2) 块内：从块头往后扫，维护一个单调栈，用一个 64 位的位掩码记录栈里元素在块内的偏移，
+//          mask[i] 是扫到 i 时的栈。块内查询 [l, r]：mask[r] 去掉 l 之前的位，最低的一位就是最值的位置
+//      (3) 跨块的查询 = 左边块的后缀 + 中间整块（稀疏表）+ 右边块的前缀
+//  Compare = less<T> 求最小值（rangeMin），greater<T> 求最大值（rangeMax）。
+//  批量查询先对一组查询预取要访问的位置，再统一计算，数组远大于 cache 时能把 cache miss 重叠起来。
+static const size_t RMQ_BATCH = 16;
+
+inline int RMQLog2(size_t x) {
+    return 63 - __builtin_clzll((unsigned long long)x);
+}
+
+template<typename T, typename Compare = less<T>>
+class SparseTable {
+private:
+    size_t n;
+    int levels;
+    vector<T> table;    // table[k * n + i]
+    Compare cmp;
+
+    const T& best(const T& a, const T& b) const {
+        return cmp(b, a) ? b : a;
+    }
+
+public:
+    explicit SparseTable(const vector<T>& nums) : n(nums.size()), levels(nums.empty() ? 0 : RMQLog2(nums.size()) + 1) {
+        table.resize((size_t)levels * n);
+        copy(nums.begin(), nums.end(), table.begin());
+        for (int k = 1; k < levels; k++) {
+            const T* prev = &table[(size_t)(k - 1) * n];
+            T* row = &table[(size_t)k * n];
+            size_t half = (size_t)1 << (k - 1);
+            for (size_t i = 0; i + 2 * half <= n; i++) {
+                row[i] = best(prev[i], prev[i + half]);
+            }
+        }
+    }
+
+    // 闭区间 [left, right]
+    T query(size_t left, size_t right) const {
+        int k = RMQLog2(right - left + 1);
+        const T* row = &table[(size_t)k * n];
+        return best(row[left], row[right + 1 - ((size_t)1 << k)]);
+    }
+
+    void queryBatch(const size_t* lefts, const size_t* rights, size_t count, T* out) const {
+        for (size_t base = 0; base < count; base += RMQ_BATCH) {
+            size_t m = min(RMQ_BATCH, count - base);
+            for (size_t i = 0; i < m; i++) {
+                size_t l = lefts[base + i], r = rights[base + i];
+                const T* row = &table[(size_t)RMQLog2(r - l + 1) * n];
+                __builtin_prefetch(row + l);
+                __builtin_prefetch(row + r + 1 - ((size_t)1 << RMQLog2(r - l + 1)));
+            }
+            for (size_t i = 0; i < m; i++) {
+                out[base + i] = query(lefts[base + i], rights[base + i]);
+            }
+        }
+    }
+
+    size_t bytes() const {
+        return table.size() * sizeof(T);
+    }
+};
+
+template<typename T, typename Compare = less<T>>
+class BlockRMQ {
+private:
+    static const size_t B = 64;
+    vector<T> data;
+    vector<uint64_t> mask;      // mask[i]：块内扫到 i 时单调栈里的元素（块内偏移）
+    vector<T> sparse;           // 块最值的稀疏表，sparse[k * nblocks + b]
+    size_t nblocks;
+    int levels;
+    Compare cmp;
+
+    const T& best(const T& a, const T& b) const {
+        return cmp(b, a) ? b : a;
+    }
+
+    // 同一块内的 [left, right] 里最值的下标
+    size_t inBlockIndex(size_t left, size_t right) const {
+        uint64_t m = mask[right] & (~0ULL << (left % B));
+        return right - right % B + __builtin_ctzll(m);
+    }
+
+    T inBlock(size_t left, size_t right) const {
+        return data[inBlockIndex(left, right)];
+    }
+
+    T blocks(size_t bl, size_t br) const {
+        int k = RMQLog2(br - bl + 1);
+        const T* row = &sparse[(size_t)k * nblocks];
+        return best(row[bl], row[br + 1 - ((size_t)1 << k)]);
+    }
+
+public:
+    explicit BlockRMQ(const vector<T>& nums) : data(nums), mask(nums.size()) {
+        size_t n = data.size();
+        nblocks = (n + B - 1) / B;
+        levels = nblocks == 0 ? 0 : RMQLog2(nblocks) + 1;
+        sparse.resize((size_t)levels * nblocks);
+        for (size_t b = 0; b < nblocks; b++) {
+            size_t start = b * B, end = min(n, start + B);
+            uint64_t stack = 0;
+            for (size_t i = start; i < end; i++) {
+                // 栈顶（最高位）不比 data[i] 更优就弹出，栈底到栈顶严格单调
+                while (stack != 0 && !cmp(data[start + RMQLog2(stack)], data[i])) {
+                    stack ^= 1ULL << RMQLog2(stack);
+                }
+                stack |= 1ULL << (i - start);
+                mask[i] = stack;
+            }
+            sparse[b] = data[start + __builtin_ctzll(mask[end - 1])];
+        }
+        for (int k = 1; k < levels; k++) {
+            const T* prev = &sparse[(size_t)(k - 1) * nblocks];
+            T* row = &sparse[(size_t)k * nblocks];
+            size_t half = (size_t)1 << (k - 1);
+            for (size_t b = 0; b + 2 * half <= nblocks; b++) {
+                row[b] = best(prev[b], prev[b + half]);
+            }
+        }
+    }
+
+    // 闭区间 [left, right]
+    T query(size_t left, size_t right) const {
+        size_t bl = left / B, br = right / B;
+        if (bl == br) {
+            return inBlock(left, right);
+        }
+        T res = best(inBlock(left, bl * B + B - 1), inBlock(br * B, right));
+        if (bl + 1 < br) {
+            res = best(res, blocks(bl + 1, br - 1));
+        }
+        return res;
+    }
+
+    // 一次查询有两级依赖：先读 mask 才知道最值在块内的哪个位置，再读 data。
+    //  所以分三轮：预取 mask 和稀疏表 -> 算出块内的位置并预取 data -> 合并结果
+    void queryBatch(const size_t* lefts, const size_t* rights, size_t count, T* out) const {
+        size_t posLeft[RMQ_BATCH], posRight[RMQ_BATCH];
+        for (size_t base = 0; base < count; base += RMQ_BATCH) {
+            size_t m = min(RMQ_BATCH, count - base);
+            for (size_t i = 0; i < m; i++) {
+                size_t l = lefts[base + i], r = rights[base + i];
+                size_t bl = l / B, br = r / B;
+                __builtin_prefetch(&mask[r]);
+                if (bl != br) {
+                    __builtin_prefetch(&mask[bl * B + B - 1]);
+                }
+                if (bl + 1 < br) {
+                    int k = RMQLog2(br - bl - 1);
+                    __builtin_prefetch(&sparse[(size_t)k * nblocks + bl + 1]);
+                    __builtin_prefetch(&sparse[(size_t)k * nblocks + br - ((size_t)1 << k)]);
+                }
+            }
+            for (size_t i = 0; i < m; i++) {
+                size_t l = lefts[base + i], r = rights[base + i];
+                size_t bl = l / B, br = r / B;
+                posLeft[i] = inBlockIndex(l, bl == br ? r : bl * B + B - 1);
+                posRight[i] = bl == br ? posLeft[i] : inBlockIndex(br * B, r);
+                __builtin_prefetch(&data[posLeft[i]]);
+                __builtin_prefetch(&data[posRight[i]]);
+            }
+            for (size_t i = 0; i < m; i++) {
+                size_t bl = lefts[base + i] / B, br = rights[base + i] / B;
+                T res = best(data[posLeft[i]], data[posRight[i]]);
+                if (bl + 1 < br) {
+                    res = best(res, blocks(bl + 1, br - 1));
+                }
+                out[base + i] = res;
+            }
+        }
+    }
+
+    size_t bytes() const {
+        return data.size() * sizeof(T) + mask.size() * sizeof(uint64_t) + sparse.size() * sizeof(T);
+    }
+};
+
+void TestRMQ() {
+    mt19937 rng(19);
+    int wrong = 0;
+    for (size_t n : {1, 2, 63, 64, 65, 1000, 4097}) {
+        vector<int> nums(n);
+        for (auto& x : nums) x = rng() % 50;     // 有大量重复值
+        SparseTable<int> stMin(nums);
+        SparseTable<int, greater<int>> stMax(nums);
+        BlockRMQ<int> brMin(nums);
+        BlockRMQ<int, greater<int>> brMax(nums);
+        vector<size_t> lefts, rights;
+        for (int t = 0; t < 5000; t++) {
+            size_t l = rng() % n, r = rng() % n;
+            if (l > r) swap(l, r);
+            lefts.push_back(l);
+            rights.push_back(r);
+            int lo = *min_element(nums.begin() + l, nums.begin() + r + 1);
+            int hi = *max_element(nums.begin() + l, nums.begin() + r + 1);
+            if (stMin.query(l, r) != lo || brMin.query(l, r) != lo) wrong++;
+            if (stMax.query(l, r) != hi || brMax.query(l, r) != hi) wrong++;
+        }
+        vector<int> a(lefts.size()), b(lefts.size());
+        stMin.queryBatch(lefts.data(), rights.data(), lefts.size(), a.data());
+        brMin.queryBatch(lefts.data(), rights.data(), lefts.size(), b.data());
+        for (size_t i = 0; i < lefts.size(); i++) {
+            if (a[i] != b[i] || a[i] != stMin.query(lefts[i], rights[i])) wrong++;
+        }
+    }
+    printf("TestRMQ wrong=%d\n", wrong);
+}
+
+// 区间最小值：线段树 vs 稀疏表 vs 分块稀疏表，逐个查询和批量查询；largeN 只测分块（稀疏表放不下）
+void BenchRMQ(size_t n = 10000000, size_t largeN = 100000000, size_t nqueries = 10000000) {
+    mt19937 rng(2019);
+    vector<size_t> lefts(nqueries), rights(nqueries);
+    vector<int> out(nqueries);
+    auto makeQueries = [&](size_t size) {
+        for (size_t i = 0; i < nqueries; i++) {
+            lefts[i] = rng() % size;
+            rights[i] = rng() % size;
+            if (lefts[i] > rights[i]) swap(lefts[i], rights[i]);
+        }
+    };
+    auto report = [&](const char* name, size_t size, size_t bytes, double buildMs, double scalarNs, double batchNs) {
+        long long checksum = 0;
+        for (int x : out) checksum += x;
+        printf("n=%9zu %-12s memory=%6zuMB build=%7.1fms query=%6.1fns ", size, name, bytes >> 20, buildMs, scalarNs);
+        if (batchNs > 0) printf("batch=%6.1fns ", batchNs);
+        printf("checksum=%lld\n", checksum);
+    };
+    auto ns = [&](chrono::steady_clock::time_point a, chrono::steady_clock::time_point b) {
+        return chrono::duration<double, nano>(b - a).count() / nqueries;
+    };
+
+    for (size_t size : {n, largeN}) {
+        vector<int> nums(size);
+        for (auto& x : nums) x = (int)rng();
+        makeQueries(size);
+
+        if (size == n) {
+            auto t0 = chrono::steady_clock::now();
+            SegmentTree<int, MinMonoid<int>> seg(nums);
+            auto t1 = chrono::steady_clock::now();
+            for (size_t i = 0; i < nqueries; i++) out[i] = seg.query(lefts[i], rights[i]);
+            auto t2 = chrono::steady_clock::now();
+            report("SegmentTree", size, 2 * size * sizeof(int), chrono::duration<double, milli>(t1 - t0).count(),
+                   ns(t1, t2), 0);
+
+            t0 = chrono::steady_clock::now();
+            SparseTable<int> st(nums);
+            t1 = chrono::steady_clock::now();
+            for (size_t i = 0; i < nqueries; i++) out[i] = st.query(lefts[i], rights[i]);
+            t2 = chrono::steady_clock::now();
+            st.queryBatch(lefts.data(), rights.data(), nqueries, out.data());
+            auto t3 = chrono::steady_clock::now();
+            report("SparseTable", size, st.bytes(), chrono::duration<double, milli>(t1 - t0).count(),
+                   ns(t1, t2), ns(t2, t3));
+        }
+
+        auto t0 = chrono::steady_clock::now();
+        BlockRMQ<int> br(nums);
+        auto t1 = chrono::steady_clock::now();
+        for (size_t i = 0; i < nqueries; i++) out[i] = br.query(lefts[i], rights[i]);
+        auto t2 = chrono::steady_clock::now();
+        br.queryBatch(lefts.data(), rights.data(), nqueries, out.data());
+        auto t3 = chrono::steady_clock::now();
+        report("BlockRMQ", size, br.bytes(), chrono::duration<double, milli>(t1 - t0).count(), ns(t1, t2), ns(t2, t3));
+    }
+}
+
+
+//-----------------------------------------------------------------------------------
+//
+//          B 叉静态线段树 WideSegmentTree - 一个结点一条 cache line
+//
+//-----------------------------------------------------------------------------------
+// NumArray 在 10^8 个元素上，一次 sumRange 要沿着 4n 的数组递归访问约 2 log n 个结点，几乎每一层都是一次 cache miss，
+//  而且下一层的地址要等上一层算完，这些 miss 是串行的。
+// WideSegmentTree（Algorithmica 的 wide segment tree）：
+//  (1) 16 叉：一个结点 16 个 int32 = 64 字节，正好一条 cache line，按 64 字节对齐；n = 10^8 时只有 7 层
+//  (2) 第 h 层的第 g 个位置保存：它在父结点里前面那些兄弟（各覆盖 16^h 个元素）的和。
+//      把 k 写成 16 进制，前缀和 [0, k) 就是每一层取一个数相加：sum(h) tree[h][k >> 4h]
+//      每层的地址只和 k 有关，和上一层读到的值无关，所以 7 次访存可以同时发出去，不是一条依赖链
+//  (3) 单点加 delta：每一层把父结点里位于它后面的兄弟都加上 delta，
+//      用 SIMD 比较 "车道号 > 位置" 生成掩码，一条 cache line 两次 AVX2 加法就改完
+//  (4) 读多写少：set 先放进队列，flush 时一次性处理。更新很多（超过 n / 64 个）时直接 O(n) 重建整棵树，
+//      比逐个更新快；更新少时逐个做 (3)
+//  和 NumArray 一样存 int，和超过 int 的范围会溢出。
+class WideSegmentTree {
+private:
+    static const int B = 16;
+    size_t n;
+    int height;
+    vector<size_t> offset;      // 第 h 层在 tree 里的起始下标，每层的长度是 16 的倍数
+    int32_t* tree;              // 所有层连续放在一起，64 字节对齐
+    void* mem;
+    vector<int32_t> vals;       // 原数组，重建时用
+    vector<pair<size_t, int32_t>> pending;
+
+    // node[j] += delta，对所有 j > pos
+    static void addAfter(int32_t* node, int pos, int32_t delta) {
+#if defined(__AVX2__)
+        const __m256i lanesLow = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i lanesHigh = _mm256_setr_epi32(8, 9, 10, 11, 12, 13, 14, 15);
+        __m256i p = _mm256_set1_epi32(pos), d = _mm256_set1_epi32(delta);
+        __m256i low = _mm256_load_si256((const __m256i*)node);
+        __m256i high = _mm256_load_si256((const __m256i*)(node + 8));
+        low = _mm256_add_epi32(low, _mm256_and_si256(_mm256_cmpgt_epi32(lanesLow, p), d));
+        high = _mm256_add_epi32(high, _mm256_and_si256(_mm256_cmpgt_epi32(lanesHigh, p), d));
+        _mm256_store_si256((__m256i*)node, low);
+        _mm256_store_si256((__m256i*)(node + 8), high);
+#else
+        for (int j = pos + 1; j < B; j++) {
+            node[j] += delta;
+        }
+#endif
+    }
+
+    void rebuild() {
+        vector<int32_t> sums(vals);     // 当前层每个位置覆盖的元素之和
+        for (int h = 0; h < height; h++) {
+            int32_t* level = tree + offset[h];
+            size_t len = offset[h + 1] - offset[h];
+            vector<int32_t> parent(len / B, 0);
+            for (size_t node = 0; node < len / B; node++) {
+                int32_t running = 0;
+                for (int j = 0; j < B; j++) {
+                    size_t g = node * B + j;
+                    level[g] = running;
+                    if (g < sums.size()) running += sums[g];
+                }
+                parent[node] = running;
+            }
+            sums.swap(parent);
+        }
+    }
+
+    void addNow(size_t index, int32_t delta) {
+        for (int h = 0; h < height; h++) {
+            size_t g = index >> (4 * h);
+            addAfter(tree + offset[h] + (g & ~(size_t)(B - 1)), (int)(g & (B - 1)), delta);
+        }
+    }
+
+public:
+    explicit WideSegmentTree(const vector<int>& nums) : n(nums.size()), height(0), vals(nums.begin(), nums.end()) {
+        // 第 h 层有 ceil(n / 16^h) 个位置，前缀和还要能取到下标 k = n，所以每层多留一个再补齐到 16 的倍数。
+        //  一直加到最高层的 n >> 4h < 16，也就是 k = n 在最高层也落在第一个结点里
+        offset.push_back(0);
+        size_t groups = n;
+        do {
+            offset.push_back(offset.back() + (groups + 1 + B - 1) / B * B);
+            height++;
+            groups = (groups + B - 1) / B;
+        } while ((n >> (4 * (height - 1))) >= (size_t)B);
+        mem = malloc(offset.back() * sizeof(int32_t) + 63);
+        assert(mem);
+        tree = (int32_t*)(((uintptr_t)mem + 63) & ~(uintptr_t)63);
+        rebuild();
+    }
+
+    ~WideSegmentTree() {
+        free(mem);
+    }
+
+    WideSegmentTree(const WideSegmentTree&) = delete;
+    WideSegmentTree& operator=(const WideSegmentTree&) = delete;
+
+    // 前 count 个元素的和，即 [0, count)
+    int prefixSum(size_t count) const {
+        int32_t sum = 0;
+        for (int h = 0; h < height; h++) {
+            sum += tree[offset[h] + (count >> (4 * h))];
+        }
+        return sum;
+    }
+
+    int sumRange(size_t left, size_t right) const {
+        return prefixSum(right + 1) - prefixSum(left);
+    }
+
+    // 立即生效的单点加
+    void add(size_t index, int delta) {
+        vals[index] += delta;
+        addNow(index, delta);
+    }
+
+    // 排队，flush 之后才对查询可见
+    void set(size_t index, int val) {
+        pending.push_back({index, val});
+    }
+
+    void flush() {
+        if (pending.empty()) return;
+        bool full = pending.size() > n / 64;
+        for (const auto& p : pending) {
+            int32_t delta = p.second - vals[p.first];
+            vals[p.first] = p.second;
+            if (!full) addNow(p.first, delta);
+        }
+        if (full) rebuild();
+        pending.clear();
+    }
+
+    size_t bytes() const {
+        return offset.back() * sizeof(int32_t);
+    }
+};
+
+void TestWideSegmentTree() {
+    mt19937 rng(21);
+    int wrong = 0;
+    for (size_t n : {1, 15, 16, 17, 255, 256, 257, 5000, 70000}) {
+        vector<int> ref(n);
+        for (auto& x : ref) x = rng() % 100;
+        WideSegmentTree tree(ref);
+        for (int t = 0; t < 3000; t++) {
+            size_t l = rng() % n, r = rng() % n;
+            if (l > r) swap(l, r);
+            switch (rng() % 4) {
+                case 0: {
+                    int v = rng() % 100;
+                    tree.add(l, v - ref[l]);
+                    ref[l] = v;
+                    break;
+                }
+                case 1: {
+                    // 一批 set：小批量逐个加，大批量整棵重建
+                    size_t k = rng() % 2 ? 1 + rng() % 4 : n / 32 + 1;
+                    for (size_t i = 0; i < k; i++) {
+                        size_t idx = rng() % n;
+                        ref[idx] = rng() % 100;
+                        tree.set(idx, ref[idx]);
+                    }
+                    tree.flush();
+                    break;
+                }
+                default: {
+                    int s = 0;
+                    for (size_t i = l; i <= r; i++) s += ref[i];
+                    if (tree.sumRange(l, r) != s) wrong++;
+                }
+            }
+        }
+    }
+    printf("TestWideSegmentTree wrong=%d\n", wrong);
+}
+
+// 区间和的查询延迟：从 L2 大小到远超 L3，NumArray / SegmentTree(2n) / WideSegmentTree。
+//  latency：下一个查询的端点依赖上一个查询的结果，测的是一次查询完整的延迟；
+//  throughput：查询之间互相独立，CPU 可以把多个查询的 cache miss 重叠起来
+void BenchWideSegmentTree(int minLog = 18, int maxLog = 28, size_t nqueries = 2000000) {
+    mt19937 rng(2021);
+    for (int lg = minLog; lg <= maxLog; lg += (lg < 24 ? 3 : 2)) {
+        size_t n = (size_t)1 << lg;
+        vector<size_t> ql(nqueries), qr(nqueries);
+        for (size_t i = 0; i < nqueries; i++) {
+            ql[i] = rng() % n;
+            qr[i] = rng() % n;
+            if (ql[i] > qr[i]) swap(ql[i], qr[i]);
+        }
+        auto run = [&](const char* name, size_t bytes, const function<int(size_t, size_t)>& query) {
+            long long checksum = 0;
+            auto t0 = chrono::steady_clock::now();
+            for (size_t i = 0; i < nqueries; i++) checksum += query(ql[i], qr[i]);
+            auto t1 = chrono::steady_clock::now();
+            int prev = 0;
+            for (size_t i = 0; i < nqueries; i++) {
+                size_t l = ql[i] ^ (size_t)(prev & 1);     // l 依赖上一次的结果，l ^ 1 仍然 <= r 或者等于 r + 1 时退回 l
+                if (l > qr[i]) l = ql[i];
+                prev = query(l, qr[i]);
+                checksum += prev;
+            }
+            auto t2 = chrono::steady_clock::now();
+            printf("n=2^%d %-16s memory=%6zuMB throughput=%6.1fns latency=%6.1fns checksum=%lld\n", lg, name, bytes >> 20,
+                   chrono::duration<double, nano>(t1 - t0).count() / nqueries,
+                   chrono::duration<double, nano>(t2 - t1).count() / nqueries, checksum);
+        };
+        vector<int> nums(n);
+        for (auto& x : nums) x = rng() % 16;    // 总和不超过 2^32 / 2，int 不溢出
+        if (4 * n * sizeof(int) <= ((size_t)1 << 30)) {
+            NumArray recursive(nums);
+            run("NumArray", 4 * n * sizeof(int), [&](size_t l, size_t r) { return recursive.sumRange(l, r); });
+        }
+        {
+            SegmentTree<int> iterative(nums);
+            run("SegmentTree(2n)", 2 * n * sizeof(int), [&](size_t l, size_t r) { return iterative.query(l, r); });
+        }
+        WideSegmentTree wide(nums);
+        vector<int>().swap(nums);
+        run("WideSegmentTree", wide.bytes(), [&](size_t l, size_t r) { return wide.sumRange(l, r); });
+
+        size_t batch = n / 16;
+        for (size_t i = 0; i < batch; i++) wide.set(rng() % n, rng() % 16);
+        auto t0 = chrono::steady_clock::now();
+        wide.flush();
+        auto t1 = chrono::steady_clock::now();
+        for (size_t i = 0; i < 100000; i++) wide.set(rng() % n, rng() % 16);
+        wide.flush();
+        auto t2 = chrono::steady_clock::now();
+        printf("n=2^%d WideSegmentTree flush %zu sets (rebuild)=%.1fms, 100000 sets (incremental)=%.1fms\n", lg, batch,
+               chrono::duration<double, milli>(t1 - t0).count(), chrono::duration<double, milli>(t2 - t1).count());
+    }
+}
+
+
+//  1893检查是否区域内所有整数都被覆盖
+bool isCovered(vector<vector<int>>& ranges, int left, int right) {
+    vector<int> diff(52, 0);   // 差分数组
+    for(const auto& range: ranges) {
+        int l = range[0], r = range[1];
+        ++diff[l];
+        --diff[r+1];
+    }
+    // 前缀和
+    int presum = 0;
+    for (int i = 1; i <= 50; ++i) {
+        presum += diff[i];
+        if (i >= left && i <= right && presum <= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------------
+//
+//          区间覆盖引擎 CoverageIndex - isCovered 的推广
+//
+//-----------------------------------------------------------------------------------
+// isCovered 的差分数组只能用在 [1, 50] 这么小的值域上。坐标到 10^9、区间有几百万个时：
+//  (1) 稀疏的情况：不开整个值域的差分数组，只把所有区间的起点 l 和终点 r + 1 排序（基数排序，
+//      整数 key 每趟 8 位，4 趟排完 32 位），然后扫一遍，得到一组分段常数：
+//      breaks[i] 是第 i 段的起点，depth[i] 是 [breaks[i], breaks[i+1]) 上的覆盖层数（最后一段的 depth 是 0，一直延伸到正无穷）
+//  (2) 稠密的情况：值域跨度不超过区间数的若干倍时，直接开差分数组，用 SIMD 做前缀和（AVX2 一次 8 个 int），
+//      再把相同的值合并成段。两种情况得到的分段完全一样，后面的查询共用
+//  (3) 查询：
+//      - 是否完全覆盖 [l, r]：找到 l 所在的段，预处理每段之后第一个 depth = 0 的段，它的起点 > r 就是覆盖了
+//      - 最大重叠层数：l、r 所在段之间的区间最大值，用上面的 BlockRMQ，O(1)
+//      - 没被覆盖的空隙：从 l 所在的段开始，沿着"下一个 depth = 0 的段"跳
+//  (4) 批量查询：先把查询按左端点基数排序，相邻查询的段号很接近，用倍增（galloping）从上一个位置往后找，
+//      比每个查询单独二分少很多次 cache miss
+//  区间都是闭区间 [l, r]，和 isCovered 一致。
+
+// 按 key 的 [lowBit, highBit) 位排序，LSD 基数排序，每趟 8 位，稳定
+void RadixSortU64(vector<uint64_t>& a, int lowBit, int highBit) {
+    vector<uint64_t> buf(a.size());
+    for (int shift = lowBit; shift < highBit; shift += 8) {
+        size_t count[257] = {0};
+        for (uint64_t x : a) count[((x >> shift) & 0xff) + 1]++;
+        if (count[((a.empty() ? 0 : a[0]) >> shift & 0xff) + 1] == a.size()) continue;    // 这 8 位全相同，跳过这一趟
+        for (int i = 0; i < 256; i++) count[i + 1] += count[i];
+        for (uint64_t x : a) buf[count[(x >> shift) & 0xff]++] = x;
+        a.swap(buf);
+    }
+}
+
+// 原地求前缀和（包含自己）
+void PrefixSumInt32(int32_t* a, size_t n) {
+    size_t i = 0;
+    int32_t running = 0;
+#if defined(__AVX2__)
+    __m256i carry = _mm256_setzero_si256();
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        // 两个 128 位的半边各自做 4 个数的前缀和
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+        // 低半边的总和加到高半边上
+        __m256i low = _mm256_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+        x = _mm256_add_epi32(x, _mm256_permute2x128_si256(low, low, 0x08));
+        x = _mm256_add_epi32(x, carry);
+        _mm256_storeu_si256((__m256i*)(a + i), x);
+        carry = _mm256_permutevar8x32_epi32(x, _mm256_set1_epi32(7));
+    }
+    if (i > 0) running = a[i - 1];
+#endif
+    for (; i < n; i++) {
+        running += a[i];
+        a[i] = running;
+    }
+}
+
+class CoverageIndex {
+private:
+    vector<long long> breaks;       // 每段的起点，严格递增
+    vector<int> depth;              // 每段的覆盖层数，相邻两段不同，最后一段是 0
+    vector<uint32_t> nextZero;      // nextZero[i]：下标 >= i 的第一个 depth = 0 的段
+    BlockRMQ<int, greater<int>>* maxRMQ;
+    bool dense;
+
+    void push(long long x, int d) {
+        if (!depth.empty() && depth.back() == d) return;
+        breaks.push_back(x);
+        depth.push_back(d);
+    }
+
+    void buildDense(const vector<pair<long long, long long>>& intervals, long long lo, long long hi) {
+        vector<int32_t> diff((size_t)(hi - lo + 1), 0);
+        for (const auto& it : intervals) {
+            if (it.first > it.second) continue;
+            diff[it.first - lo]++;
+            diff[it.second + 1 - lo]--;
+        }
+        PrefixSumInt32(diff.data(), diff.size());
+        for (size_t i = 0; i < diff.size(); i++) {
+            push(lo + (long long)i, diff[i]);
+        }
+    }
+
+    void buildSparse(const vector<pair<long long, long long>>& intervals, long long lo, long long hi) {
+        vector<uint64_t> starts, ends;
+        starts.reserve(intervals.size());
+        ends.reserve(intervals.size());
+        for (const auto& it : intervals) {
+            if (it.first > it.second) continue;
+            starts.push_back((uint64_t)(it.first - lo));
+            ends.push_back((uint64_t)(it.second + 1 - lo));
+        }
+        int bits = 64 - __builtin_clzll((unsigned long long)(hi - lo) | 1);
+        RadixSortU64(starts, 0, bits);
+        RadixSortU64(ends, 0, bits);
+        int d = 0;
+        size_t i = 0, j = 0;
+        while (i < starts.size() || j < ends.size()) {
+            uint64_t x = j == ends.size() || (i < starts.size() && starts[i] < ends[j]) ? starts[i] : ends[j];
+            while (i < starts.size() && starts[i] == x) { d++; i++; }
+            while (j < ends.size() && ends[j] == x) { d--; j++; }
+            push(lo + (long long)x, d);
+        }
+    }
+
+    // 坐标 x 所在的段，在所有段之前返回 -1
+    long long locate(long long x) const {
+        return (long long)(upper_bound(breaks.begin(), breaks.end(), x) - breaks.begin()) - 1;
+    }
+
+    // 已知 x 所在的段 >= from，从 from 开始倍增再二分
+    long long locateFrom(long long x, long long from) const {
+        size_t lo = (size_t)max(from, 0LL), step = 1, hi = lo;
+        while (hi < breaks.size() && breaks[hi] <= x) {
+            lo = hi;
+            hi = lo + step;
+            step *= 2;
+        }
+        hi = min(hi, breaks.size());
+        return (long long)(upper_bound(breaks.begin() + lo, breaks.begin() + hi, x) - breaks.begin()) - 1;
+    }
+
+    bool coveredAt(long long seg, long long right) const {
+        if (seg < 0 || depth[seg] == 0) return false;
+        uint32_t z = nextZero[seg];     // 最后一段的 depth 是 0，一定存在
+        return breaks[z] > right;
+    }
+
+    int maxDepthAt(long long segLeft, long long segRight) const {
+        if (segRight < 0) return 0;
+        return maxRMQ->query((size_t)max(segLeft, 0LL), (size_t)segRight);
+    }
+
+    void gapsAt(long long seg, long long left, long long right, vector<pair<long long, long long>>& out) const {
+        if (seg < 0) {
+            out.push_back({left, min(right, breaks.empty() ? right : breaks[0] - 1)});
+            if (breaks.empty()) return;     // 没有有效区间，整段都是空隙
+            seg = 0;
+        }
+        for (size_t z = nextZero[seg]; z < breaks.size() && breaks[z] <= right; ) {
+            long long end = z + 1 < breaks.size() ? breaks[z + 1] - 1 : right;
+            out.push_back({max(left, breaks[z]), min(right, end)});
+            if (z + 1 >= breaks.size()) break;
+            z = nextZero[z + 1];
+        }
+    }
+
+    // 批量查询的公共部分：按 keys 排序之后依次定位，segs[i] 是 keys[i] 所在的段
+    void locateBatch(const long long* keys, size_t count, vector<long long>& segs) const {
+        segs.resize(count);
+        if (breaks.empty()) {
+            fill(segs.begin(), segs.end(), -1);
+            return;
+        }
+        // key 先截到 [breaks[0] - 1, breaks.back()]，相对偏移放在高 32 位，下标放在低 32 位
+        long long lo = breaks[0] - 1, hi = breaks.back();
+        int bits = 64 - __builtin_clzll((unsigned long long)(hi - lo) | 1);
+        if (bits > 32 || count > 0xffffffffULL) {
+            // 跨度或查询数放不进 32 位，打包不下，逐个二分
+            for (size_t i = 0; i < count; i++) segs[i] = locate(keys[i]);
+            return;
+        }
+        vector<uint64_t> order(count);
+        for (size_t i = 0; i < count; i++) {
+            long long k = min(max(keys[i], lo), hi) - lo;
+            order[i] = ((uint64_t)k << 32) | i;
+        }
+        RadixSortU64(order, 32, 32 + bits);
+        long long seg = -1;
+        for (uint64_t packed : order) {
+            size_t i = packed & 0xffffffffULL;
+            seg = locateFrom(keys[i], seg);
+            segs[i] = seg;
+        }
+    }
+
+public:
+    // intervals：闭区间 [l, r]；l > r 的区间忽略
+    explicit CoverageIndex(const vector<pair<long long, long long>>& intervals) : maxRMQ(NULL), dense(false) {
+        long long lo = numeric_limits<long long>::max(), hi = numeric_limits<long long>::min();
+        size_t valid = 0;
+        for (const auto& it : intervals) {
+            if (it.first > it.second) continue;
+            lo = min(lo, it.first);
+            hi = max(hi, it.second + 1);
+            valid++;
+        }
+        if (valid > 0) {
+            // 跨度不超过区间数的 8 倍：差分数组比排序 2 * valid 个端点更快
+            dense = (unsigned long long)(hi - lo) <= 8ULL * valid && hi - lo < ((long long)1 << 30);
+            if (dense) buildDense(intervals, lo, hi);
+            else buildSparse(intervals, lo, hi);
+        }
+        nextZero.resize(breaks.size());
+        for (size_t i = breaks.size(); i-- > 0; ) {
+            nextZero[i] = depth[i] == 0 ? (uint32_t)i : nextZero[i + 1];
+        }
+        maxRMQ = new BlockRMQ<int, greater<int>>(depth);
+    }
+
+    ~CoverageIndex() {
+        delete maxRMQ;
+    }
+
+    CoverageIndex(const CoverageIndex&) = delete;
+    CoverageIndex& operator=(const CoverageIndex&) = delete;
+
+    // [left, right] 里的每个整数是否都至少被一个区间覆盖
+    bool isCovered(long long left, long long right) const {
+        return coveredAt(locate(left), right);
+    }
+
+    // [left, right] 上最多有多少个区间重叠
+    int maxDepth(long long left, long long right) const {
+        return maxDepthAt(locate(left), locate(right));
+    }
+
+    // [left, right] 里没被覆盖的部分，按从左到右的顺序追加到 out
+    void gaps(long long left, long long right, vector<pair<long long, long long>>& out) const {
+        gapsAt(locate(left), left, right, out);
+    }
+
+    void isCoveredBatch(const long long* lefts, const long long* rights, size_t count, bool* out) const {
+        vector<long long> segs;
+        locateBatch(lefts, count, segs);
+        for (size_t i = 0; i < count; i++) {
+            out[i] = coveredAt(segs[i], rights[i]);
+        }
+    }
+
+    void maxDepthBatch(const long long* lefts, const long long* rights, size_t count, int* out) const {
+        vector<long long> segLeft, segRight;
+        locateBatch(lefts, count, segLeft);
+        locateBatch(rights, count, segRight);
+        for (size_t i = 0; i < count; i++) {
+            out[i] = maxDepthAt(segLeft[i], segRight[i]);
+        }
+    }
+
+    // 第 i 个查询的空隙是 out[offsets[i]] .. out[offsets[i + 1] - 1]
+    void gapsBatch(const long long* lefts, const long long* rights, size_t count,
+                   vector<pair<long long, long long>>& out, vector<size_t>& offsets) const {
+        vector<long long> segs;
+        locateBatch(lefts, count, segs);
+        out.clear();
+        offsets.assign(1, 0);
+        for (size_t i = 0; i < count; i++) {
+            gapsAt(segs[i], lefts[i], rights[i], out);
+            offsets.push_back(out.size());
+        }
+    }
+
+    size_t segmentCount() const {
+        return breaks.size();
+    }
+
+    bool isDense() const {
+        return dense;
+    }
+};
+
+// 暴力：[left, right] 按所有端点切成小段，逐段数覆盖层数
+void CoverageBruteForce(const vector<pair<long long, long long>>& intervals, long long left, long long right,
+                        bool& covered, int& maxDepth, vector<pair<long long, long long>>& gaps) {
+    vector<long long> points = {left, right + 1};
+    for (const auto& it : intervals) {
+        if (it.first > left && it.first <= right) points.push_back(it.first);
+        if (it.second + 1 > left && it.second + 1 <= right) points.push_back(it.second + 1);
+    }
+    sort(points.begin(), points.end());
+    points.erase(unique(points.begin(), points.end()), points.end());
+    covered = true;
+    maxDepth = 0;
+    gaps.clear();
+    for (size_t k = 0; k + 1 < points.size(); k++) {
+        int d = 0;
+        for (const auto& it : intervals) {
+            if (it.first <= points[k] && points[k] <= it.second) d++;
+        }
+        maxDepth = max(maxDepth, d);
+        if (d > 0) continue;
+        covered = false;
+        if (!gaps.empty() && gaps.back().second + 1 == points[k]) gaps.back().second = points[k + 1] - 1;
+        else gaps.push_back({points[k], points[k + 1] - 1});
+    }
+}
+
+void TestCoverageIndex() {
+    mt19937_64 rng(20);
+    int wrong = 0;
+    for (long long span : {60LL, 1000000000LL, 1LL << 40}) {     // 1 << 40：跨度超过 2^32，批量查询退回逐个二分
+        vector<pair<long long, long long>> intervals;
+        for (int i = 0; i < 300; i++) {
+            long long l = (long long)(rng() % span);
+            long long len = span < 100 ? (long long)(rng() % 5) : (long long)(rng() % (span / 50));
+            intervals.push_back({l, l + len - (long long)(rng() % 8 == 0)});     // 偶尔有 l > r 的空区间
+        }
+        CoverageIndex index(intervals);
+        vector<long long> lefts, rights;
+        for (int t = 0; t < 500; t++) {
+            long long l = (long long)(rng() % (span + 20)) - 10, r = l + (long long)(rng() % (span / 10 + 1));
+            lefts.push_back(l);
+            rights.push_back(r);
+            bool covered;
+            int maxDepth;
+            vector<pair<long long, long long>> expect, got;
+            CoverageBruteForce(intervals, l, r, covered, maxDepth, expect);
+            index.gaps(l, r, got);
+            if (index.isCovered(l, r) != covered || index.maxDepth(l, r) != maxDepth || got != expect) wrong++;
+        }
+        size_t q = lefts.size();
+        unique_ptr<bool[]> covered(new bool[q]);
+        vector<int> depths(q);
+        vector<pair<long long, long long>> allGaps, one;
+        vector<size_t> offsets;
+        index.isCoveredBatch(lefts.data(), rights.data(), q, covered.get());
+        index.maxDepthBatch(lefts.data(), rights.data(), q, depths.data());
+        index.gapsBatch(lefts.data(), rights.data(), q, allGaps, offsets);
+        for (size_t i = 0; i < q; i++) {
+            one.clear();
+            index.gaps(lefts[i], rights[i], one);
+            vector<pair<long long, long long>> batch(allGaps.begin() + offsets[i], allGaps.begin() + offsets[i + 1]);
+            if (covered[i] != index.isCovered(lefts[i], rights[i]) || depths[i] != index.maxDepth(lefts[i], rights[i]) ||
+                batch != one) wrong++;
+        }
+        printf("TestCoverageIndex span=%lld dense=%d segments=%zu wrong=%d\n", span, index.isDense(), index.segmentCount(), wrong);
+    }
+
+    // 没有区间、或者全是 l > r 的区间：什么都没覆盖，[left, right] 整段是一个空隙
+    for (const auto& intervals : vector<vector<pair<long long, long long>>>{{}, {{5, 3}, {10, 9}}}) {
+        CoverageIndex index(intervals);
+        long long lefts[] = {-3, 1, 7}, rights[] = {2, 5, 7};
+        bool covered[3];
+        int depths[3];
+        vector<pair<long long, long long>> allGaps, one;
+        vector<size_t> offsets;
+        index.isCoveredBatch(lefts, rights, 3, covered);
+        index.maxDepthBatch(lefts, rights, 3, depths);
+        index.gapsBatch(lefts, rights, 3, allGaps, offsets);
+        for (size_t i = 0; i < 3; i++) {
+            one.clear();
+            index.gaps(lefts[i], rights[i], one);
+            vector<pair<long long, long long>> expect = {{lefts[i], rights[i]}};
+            vector<pair<long long, long long>> batch(allGaps.begin() + offsets[i], allGaps.begin() + offsets[i + 1]);
+            if (index.isCovered(lefts[i], rights[i]) || covered[i] || index.maxDepth(lefts[i], rights[i]) != 0 ||
+                depths[i] != 0 || one != expect || batch != expect) wrong++;
+        }
+        printf("TestCoverageIndex intervals=%zu segments=%zu wrong=%d\n", intervals.size(), index.segmentCount(), wrong);
+    }
+
+    vector<int32_t> a(1003);
+    for (auto& x : a) x = (int32_t)(rng() % 7) - 3;
+    vector<int32_t> b = a;
+    PrefixSumInt32(a.data(), a.size());
+    for (size_t i = 1; i < b.size(); i++) b[i] += b[i - 1];
+    printf("PrefixSumInt32 %s\n", a == b ? "ok" : "wrong");
+}
+
+// n 个区间：稀疏（值域 10^9）和稠密（值域 n）两种情况，建索引、逐个查询、批量查询的耗时
+void BenchCoverageIndex(size_t n = 4000000, size_t nqueries = 4000000) {
+    mt19937_64 rng(2020);
+    for (long long span : {1000000000LL, (long long)n}) {
+        vector<pair<long long, long long>> intervals(n);
+        for (auto& it : intervals) {
+            it.first = (long long)(rng() % span);
+            it.second = it.first + (long long)(rng() % (span / (long long)n * 2 + 1));
+        }
+        vector<long long> lefts(nqueries), rights(nqueries);
+        for (size_t i = 0; i < nqueries; i++) {
+            lefts[i] = (long long)(rng() % span);
+            rights[i] = lefts[i] + (long long)(rng() % (span / (long long)n * 4 + 1));
+        }
+
+        auto t0 = chrono::steady_clock::now();
+        CoverageIndex index(intervals);
+        auto t1 = chrono::steady_clock::now();
+        size_t coveredCount = 0;
+        long long depthSum = 0;
+        for (size_t i = 0; i < nqueries; i++) coveredCount += index.isCovered(lefts[i], rights[i]);
+        auto t2 = chrono::steady_clock::now();
+        for (size_t i = 0; i < nqueries; i++) depthSum += index.maxDepth(lefts[i], rights[i]);
+        auto t3 = chrono::steady_clock::now();
+        unique_ptr<bool[]> covered(new bool[nqueries]);
+        vector<int> depths(nqueries);
+        index.isCoveredBatch(lefts.data(), rights.data(), nqueries, covered.get());
+        auto t4 = chrono::steady_clock::now();
+        index.maxDepthBatch(lefts.data(), rights.data(), nqueries, depths.data());
+        auto t5 = chrono::steady_clock::now();
+        vector<pair<long long, long long>> gaps;
+        vector<size_t> offsets;
+        index.gapsBatch(lefts.data(), rights.data(), nqueries, gaps, offsets);
+        auto t6 = chrono::steady_clock::now();
+
+        size_t batchCovered = 0;
+        long long batchDepth = 0;
+        for (size_t i = 0; i < nqueries; i++) {
+            batchCovered += covered[i];
+            batchDepth += depths[i];
+        }
+        auto ns = [&](chrono::steady_clock::time_point a, chrono::steady_clock::time_point b) {
+            return chrono::duration<double, nano>(b - a).count() / nqueries;
+        };
+        printf("span=%10lld %s build=%7.1fms segments=%9zu | covered %5.1fns batch %5.1fns (%zu/%zu) | "
+               "maxDepth %5.1fns batch %5.1fns (%lld/%lld) | gaps batch %5.1fns (%zu gaps)\n",
+               span, index.isDense() ? "dense " : "sparse", chrono::duration<double, milli>(t1 - t0).count(),
+               index.segmentCount(), ns(t1, t2), ns(t3, t4), coveredCount, batchCovered, ns(t2, t3), ns(t4, t5),
+               depthSum, batchDepth, ns(t5, t6), gaps.size());
+    }
+}
+
+//-----------------------------------------------------------------------------------
+//
+//          并发线段树 ConcurrentSegmentTree - 并行批量更新 + 快照读
+//
+//-----------------------------------------------------------------------------------
+// NumArray::update 一次只能改一个点，而且不能和查询并发。写多的场景下：
+//  (1) 批量更新：一批 (下标, 新值) 先按下标基数排序（key 是 下标<<32 | 序号，同一个下标只留最后一次），
+//      排好序之后切成 T 段，每个线程负责一段叶子，叶子互不相交，可以并行写
+//  (2) 内部结点自底向上一层一层地重建：每个线程把自己那段叶子的祖先逐层去重，算完一层所有线程在屏障处等齐再算上一层。
+//      相邻两段在某一层可能有同一个父结点，约定由编号小的线程算，编号大的线程跳过和前一段最后一个叶子相同的祖先
+//  (3) 快照读（left-right）：维护两棵完全相同的树，读者只读 active 那一棵。
+//      写者先把整批更新做到另一棵上，原子地切换 active，等旧树上的读者都退出之后，再把同一批更新做到旧树上。
+//      读者进入时给当前树的读者计数 +1，再确认 active 没变（变了就退出重来），
+//      所以一次查询看到的要么是整批更新之前的树，要么是之后的树，不会看到一半
+//  代价：两倍的内存，每批更新要做两遍。读者不加锁、不会被写者阻塞。
+class SpinBarrier {
+private:
+    atomic<unsigned> count;
+    atomic<unsigned> generation;
+    unsigned total;
+
+public:
+    explicit SpinBarrier(unsigned total) : count(0), generation(0), total(total) {}
+
+    void wait() {
+        unsigned gen = generation.load();
+        if (count.fetch_add(1) + 1 == total) {
+            count.store(0);
+            generation.fetch_add(1);
+        } else {
+            while (generation.load() == gen) {
+                this_thread::yield();
+            }
+        }
+    }
+};
+
+class ConcurrentSegmentTree {
+private:
+    struct alignas(64) ReaderCount {
+        atomic<long> value;
+    };
+    size_t n;
+    size_t cap;                 // 叶子数，2 的幂
+    int levels;
+    vector<long long> trees[2];
+    atomic<int> active;
+    mutable ReaderCount readers[2];
+    mutex writer;
+    unsigned threads;
+
+    // 第 t 个线程负责 updates 的 [begin, end)
+    static size_t chunkBegin(size_t count, unsigned parts, unsigned t) {
+        return count * t / parts;
+    }
+
+    void applyPart(vector<long long>& tree, const vector<pair<size_t, long long>>& updates, unsigned t, unsigned parts,
+                   SpinBarrier& barrier) const {
+        size_t begin = chunkBegin(updates.size(), parts, t), end = chunkBegin(updates.size(), parts, t + 1);
+        vector<size_t> nodes;
+        nodes.reserve(end - begin);
+        for (size_t i = begin; i < end; i++) {
+            size_t p = cap + updates[i].first;
+            tree[p] = updates[i].second;
+            nodes.push_back(p);
+        }
+        // 前一段的最后一个叶子，它的祖先由前一个线程负责
+        size_t prevLast = begin > 0 ? cap + updates[begin - 1].first : 0;
+        for (int h = 1; h <= levels; h++) {
+            barrier.wait();
+            size_t m = 0;
+            for (size_t i = 0; i < nodes.size(); i++) {
+                size_t p = nodes[i] >> 1;
+                if (m > 0 && nodes[m - 1] == p) continue;
+                if (begin > 0 && p == (prevLast >> h)) continue;
+                nodes[m++] = p;
+            }
+            nodes.resize(m);
+            for (size_t p : nodes) {
+                tree[p] = tree[2 * p] + tree[2 * p + 1];
+            }
+        }
+    }
+
+    void applyTo(vector<long long>& tree, const vector<pair<size_t, long long>>& updates) {
+        unsigned parts = (unsigned)max<size_t>(1, min<size_t>(threads, updates.size()));
+        SpinBarrier barrier(parts);
+        vector<thread> workers;
+        for (unsigned t = 1; t < parts; t++) {
+            workers.emplace_back([&, t]() { applyPart(tree, updates, t, parts, barrier); });
+        }
+        applyPart(tree, updates, 0, parts, barrier);
+        for (auto& w : workers) w.join();
+    }
+
+    // 按下标排序，同一个下标只保留最后一次
+    static vector<pair<size_t, long long>> normalize(const vector<pair<size_t, long long>>& updates, size_t cap) {
+        vector<uint64_t> keys(updates.size());
+        for (size_t i = 0; i < updates.size(); i++) {
+            keys[i] = ((uint64_t)updates[i].first << 32) | i;
+        }
+        int bits = 64 - __builtin_clzll((unsigned long long)cap);
+        // 只排高 32 位的下标：keys 本来就按序号生成，LSD 基数排序是稳定的，同一下标内仍按序号先后
+        RadixSortU64(keys, 32, 32 + bits);
+        vector<pair<size_t, long long>> sorted;
+        sorted.reserve(updates.size());
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (i + 1 < keys.size() && (keys[i + 1] >> 32) == (keys[i] >> 32)) continue;
+            sorted.push_back(updates[keys[i] & 0xffffffffULL]);
+        }
+        return sorted;
+    }
+
+public:
+    explicit ConcurrentSegmentTree(const vector<long long>& nums, unsigned threads = 1)
+        : n(nums.size()), cap(1), levels(0), active(0), threads(max(1u, threads)) {
+        assert(n < ((size_t)1 << 32));      // 排序的 key 里下标和序号各占 32 位
+        while (cap < n) {
+            cap <<= 1;
+            levels++;
+        }
+        trees[0].assign(2 * cap, 0);
+        copy(nums.begin(), nums.end(), trees[0].begin() + cap);
+        for (size_t i = cap; i-- > 1; ) {
+            trees[0][i] = trees[0][2 * i] + trees[0][2 * i + 1];
+        }
+        trees[1] = trees[0];
+        readers[0].value = 0;
+        readers[1].value = 0;
+    }
+
+    void setThreads(unsigned t) {
+        threads = max(1u, t);
+    }
+
+    // 一批 set(下标, 新值)；可以有多个生产者线程同时调用，批与批之间串行
+    void applyBatch(const vector<pair<size_t, long long>>& updates) {
+        assert(updates.size() < ((size_t)1 << 32));
+        vector<pair<size_t, long long>> sorted = normalize(updates, cap);
+        lock_guard<mutex> lock(writer);
+        int old = active.load();
+        applyTo(trees[1 - old], sorted);
+        active.store(1 - old);
+        while (readers[old].value.load() != 0) {
+            this_thread::yield();
+        }
+        applyTo(trees[old], sorted);
+    }
+
+    // 闭区间 [left, right] 的和，看到的是某一批更新之前或者之后的完整快照
+    long long query(size_t left, size_t right) const {
+        int idx;
+        for (;;) {
+            idx = active.load();
+            readers[idx].value.fetch_add(1);
+            if (active.load() == idx) break;
+            readers[idx].value.fetch_sub(1);
+        }
+        const vector<long long>& tree = trees[idx];
+        long long sum = 0;
+        for (size_t l = left + cap, r = right + cap + 1; l < r; l >>= 1, r >>= 1) {
+            if (l & 1) sum += tree[l++];
+            if (r & 1) sum += tree[--r];
+        }
+        readers[idx].value.fetch_sub(1);
+        return sum;
+    }
+
+    size_t size() const {
+        return n;
+    }
+};
+
+// 写者不停地做批量更新，每批只在若干对 (i, j) 之间挪动数值，总和不变；
+//  读者同时查询整个数组的和，只要看到的不是完整快照，总和就会对不上
+void TestConcurrentSegmentTree() {
+    const size_t n = 100000;
+    mt19937 rng(22);
+    vector<long long> shadow(n);
+    long long total = 0;
+    for (auto& x : shadow) total += x = rng() % 1000;
+    ConcurrentSegmentTree tree(shadow, 4);
+
+    atomic<bool> done(false);
+    atomic<long> torn(0), reads(0);
+    vector<thread> readers;
+    for (int t = 0; t < 2; t++) {
+        readers.emplace_back([&]() {
+            while (!done.load()) {
+                if (tree.query(0, n - 1) != total) torn++;
+                reads++;
+            }
+        });
+    }
+    int wrong = 0;
+    for (int batch = 0; batch < 200; batch++) {
+        vector<pair<size_t, long long>> updates;
+        for (int k = 0; k < 500; k++) {
+            size_t i = rng() % n, j = rng() % n;
+            if (i == j) continue;
+            long long move = (long long)(rng() % 100) - 50;
+            shadow[i] += move;
+            shadow[j] -= move;
+            updates.push_back({i, shadow[i]});
+            updates.push_back({j, shadow[j]});
+        }
+        tree.applyBatch(updates);
+        size_t l = rng() % n, r = rng() % n;
+        if (l > r) swap(l, r);
+        long long s = 0;
+        for (size_t i = l; i <= r; i++) s += shadow[i];
+        if (tree.query(l, r) != s) wrong++;
+    }
+    done = true;
+    for (auto& t : readers) t.join();
+    printf("TestConcurrentSegmentTree wrong=%d torn=%ld reads=%ld\n", wrong, torn.load(), reads.load());
+}
+
+// 每秒能做多少次单点更新：n 个叶子，每批 batch 个随机更新，同时有一个读者线程不停地做区间查询
+void BenchConcurrentSegmentTree(size_t n = (size_t)1 << 24, size_t batch = (size_t)1 << 20, unsigned maxThreads = 32) {
+    mt19937_64 rng(2022);
+    vector<long long> nums(n);
+    for (auto& x : nums) x = (long long)(rng() % 1000);
+    ConcurrentSegmentTree tree(nums);
+    vector<pair<size_t, long long>> updates(batch);
+    const int rounds = 4;
+    printf("hardware threads: %u\n", thread::hardware_concurrency());
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        tree.setThreads(threads);
+        atomic<bool> done(false);
+        atomic<long> queries(0);
+        long long sink = 0;
+        thread reader([&]() {
+            mt19937 qrng(threads);
+            long long local = 0;
+            while (!done.load()) {
+                size_t l = qrng() % n, r = qrng() % n;
+                if (l > r) swap(l, r);
+                local += tree.query(l, r);
+                queries++;
+            }
+            sink = local;
+        });
+        double seconds = 0;
+        for (int round = 0; round < rounds; round++) {
+            for (auto& u : updates) u = {rng() % n, (long long)(rng() % 1000)};
+            auto t0 = chrono::steady_clock::now();
+            tree.applyBatch(updates);
+            auto t1 = chrono::steady_clock::now();
+            seconds += chrono::duration<double>(t1 - t0).count();
+        }
+        done = true;
+        reader.join();
+        printf("threads=%2u updates/s=%6.2fM  concurrent queries/s=%6.2fM (sink %lld)\n", threads,
+               rounds * batch / seconds / 1e6, queries.load() / seconds / 1e6, sink & 1);
+    }
+}
+
+//-----------------------------------------------------------------------------------
+//
+//          二维网格的子矩形求和 / 求最大值
+//
+//-----------------------------------------------------------------------------------
+// solveXO、trapRainWaterII 这类网格问题里，"某个子矩形的和/最大值"每次都整块扫一遍，4096 x 4096 的网格一次就是上千万次访问。
+//  - 求和：上面的 FenwickTree2D，单点修改、子矩形求和都是 O(log R * log C)
+//  - 最大值：树状数组不能做（max 没有逆运算），用树套树 SegmentTree2D：外层按行、内层按列的 2n 线段树，
+//      整个 (2R) x (2C) 的表行优先放在一块连续内存里，修改和查询都是两层自底向上的循环，O(log R * log C)
+//      Monoid 需要满足交换律（最大值、最小值、和都满足）
+//  - GridRangeQuery 把两者和原网格组合在一起：单点 set、子矩形求和、子矩形最大值，以及批量查询
+struct GridRect {
+    size_t row1, col1, row2, col2;      // 闭区间 [row1, row2] x [col1, col2]
+};
+
+template<typename T, typename Monoid = MaxMonoid<T>>
+class SegmentTree2D {
+private:
+    size_t rows, cols;
+    vector<T> tree;     // tree[i * 2cols + j]：外层结点 i、内层结点 j
+
+    T& at(size_t i, size_t j) { return tree[i * 2 * cols + j]; }
+    const T& at(size_t i, size_t j) const { return tree[i * 2 * cols + j]; }
+
+    T queryRow(size_t i, size_t col1, size_t col2) const {
+        const T* line = &tree[i * 2 * cols];
+        T res = Monoid::identity();
+        for (size_t l = col1 + cols, r = col2 + cols + 1; l < r; l >>= 1, r >>= 1) {
+            if (l & 1) res = Monoid::op(res, line[l++]);
+            if (r & 1) res = Monoid::op(res, line[--r]);
+        }
+        return res;
     }
 
-    void change(int index, int val, int node, int s, int e) {
-        if (s == e) {
-            segmentTree[node] = val;
-            return;
+public:
+    // grid 是 rows * cols 的行优先数组
+    SegmentTree2D(const vector<T>& grid, size_t rows, size_t cols)
+        : rows(rows), cols(cols), tree(4 * rows * cols, Monoid::identity()) {
+        assert(grid.size() == rows * cols);
+        for (size_t r = 0; r < rows; r++) {
+            copy(grid.begin() + r * cols, grid.begin() + (r + 1) * cols, tree.begin() + (rows + r) * 2 * cols + cols);
+            for (size_t j = cols; j-- > 1; ) {
+                at(rows + r, j) = Monoid::op(at(rows + r, 2 * j), at(rows + r, 2 * j + 1));
+            }
         }
-        int m = s + (e - s) / 2;
-        if (index <= m) {
-            change(index, val, node * 2 + 1, s, m);
-        } else {
-            change(index, val, node * 2 + 2, m + 1, e);
+        for (size_t i = rows; i-- > 1; ) {
+            for (size_t j = 1; j < 2 * cols; j++) {
+                at(i, j) = Monoid::op(at(2 * i, j), at(2 * i + 1, j));
+            }
         }
-        segmentTree[node] = segmentTree[node * 2 + 1] + segmentTree[node * 2 + 2];
     }
 
-    int range(int left, int right, int node, int s, int e) {
-        if (left == s && right == e) {
-            return segmentTree[node];
+    void update(size_t row, size_t col, const T& val) {
+        size_t i = row + rows;
+        at(i, col + cols) = val;
+        for (size_t j = (col + cols) >> 1; j > 0; j >>= 1) {
+            at(i, j) = Monoid::op(at(i, 2 * j), at(i, 2 * j + 1));
         }
-        int m = s + (e - s) / 2;
-        if (right <= m) {
-            return range(left, right, node * 2 + 1, s, m);
-        } else if (left > m) {
-            return range(left, right, node * 2 + 2, m + 1, e);
-        } else {
-            return range(left, m, node * 2 + 1, s, m) + range(m + 1, right, node * 2 + 2, m + 1, e);
+        for (i >>= 1; i > 0; i >>= 1) {
+            for (size_t j = col + cols; j > 0; j >>= 1) {
+                at(i, j) = Monoid::op(at(2 * i, j), at(2 * i + 1, j));
+            }
+        }
+    }
+
+    T query(size_t row1, size_t col1, size_t row2, size_t col2) const {
+        T res = Monoid::identity();
+        for (size_t l = row1 + rows, r = row2 + rows + 1; l < r; l >>= 1, r >>= 1) {
+            if (l & 1) res = Monoid::op(res, queryRow(l++, col1, col2));
+            if (r & 1) res = Monoid::op(res, queryRow(--r, col1, col2));
         }
+        return res;
+    }
+};
+
+class GridRangeQuery {
+private:
+    size_t rows, cols;
+    vector<int> grid;
+    FenwickTree2D<long long> sums;
+    SegmentTree2D<int, MaxMonoid<int>> maxima;
+
+    static vector<int> flatten(const vector<vector<int>>& g) {
+        vector<int> flat;
+        for (const auto& row : g) flat.insert(flat.end(), row.begin(), row.end());
+        return flat;
     }
 
 public:
-    NumArray(vector<int>& nums) : n(nums.size()), segmentTree(nums.size() * 4) {
-        build(0, 0, n - 1, nums);
+    GridRangeQuery(const vector<int>& grid, size_t rows, size_t cols)
+        : rows(rows), cols(cols), grid(grid), sums(vector<long long>(grid.begin(), grid.end()), rows, cols),
+          maxima(grid, rows, cols) {}
+
+    explicit GridRangeQuery(const vector<vector<int>>& g)
+        : GridRangeQuery(flatten(g), g.size(), g.empty() ? 0 : g[0].size()) {}
+
+    void set(size_t row, size_t col, int val) {
+        int& cell = grid[row * cols + col];
+        sums.add(row, col, (long long)val - cell);
+        maxima.update(row, col, val);
+        cell = val;
     }
 
-    void update(int index, int val) {
-        change(index, val, 0, 0, n - 1);
+    int get(size_t row, size_t col) const {
+        return grid[row * cols + col];
     }
 
-    int sumRange(int left, int right) {
-        return range(left, right, 0, 0, n - 1);
+    long long rectSum(const GridRect& q) const {
+        return sums.rectSum(q.row1, q.col1, q.row2, q.col2);
     }
-};
 
+    int rectMax(const GridRect& q) const {
+        return maxima.query(q.row1, q.col1, q.row2, q.col2);
+    }
 
-//  1893检查是否区域内所有整数都被覆盖
-bool isCovered(vector<vector<int>>& ranges, int left, int right) {
-    vector<int> diff(52, 0);   // 差分数组
-    for(const auto& range: ranges) {
-        int l = range[0], r = range[1];
-        ++diff[l];
-        --diff[r+1];
+    // 批量接口只是方便调用，和逐个查询一样快。试过两种批量优化，4096 x 4096 上都没有稳定的收益：
+    //  - 每 16 个查询一组先预取再计算：两种树的访问地址都只由坐标算出来，没有依赖链，
+    //      单个查询内部的 cache miss 已经被乱序执行重叠了，预取只是多走一遍
+    //  - 按 (row1, col1) 基数排序后再查：排序每个查询要 ~45ns，小矩形求和省下的差不多也就这么多，最大值反而变慢
+    //  耗时主要在两条 lowbit 链/左右边界交替前进时难以预测的分支上
+    void rectSumBatch(const GridRect* queries, size_t count, long long* out) const {
+        for (size_t i = 0; i < count; i++) out[i] = rectSum(queries[i]);
     }
-    // 前缀和
-    int presum = 0;
-    for (int i = 1; i <= 50; ++i) {
-        presum += diff[i];
-        if (i >= left && i <= right && presum <= 0) {
-            return false;
+
+    void rectMaxBatch(const GridRect* queries, size_t count, int* out) const {
+        for (size_t i = 0; i < count; i++) out[i] = rectMax(queries[i]);
+    }
+};
+
+void TestGridRangeQuery() {
+    mt19937 rng(23);
+    int wrong = 0;
+    for (size_t rows : {1, 7, 64}) {
+        size_t cols = rows == 1 ? 33 : rows + 5;
+        vector<vector<int>> ref(rows, vector<int>(cols));
+        for (auto& row : ref) for (auto& x : row) x = (int)(rng() % 2001) - 1000;
+        GridRangeQuery grid(ref);
+        vector<GridRect> batch;
+        for (int t = 0; t < 20000; t++) {
+            GridRect q{rng() % rows, rng() % cols, rng() % rows, rng() % cols};
+            if (q.row1 > q.row2) swap(q.row1, q.row2);
+            if (q.col1 > q.col2) swap(q.col1, q.col2);
+            if (t % 3 == 0) {
+                int v = (int)(rng() % 2001) - 1000;
+                ref[q.row1][q.col1] = v;
+                grid.set(q.row1, q.col1, v);
+                continue;
+            }
+            long long s = 0;
+            int m = numeric_limits<int>::min();
+            for (size_t i = q.row1; i <= q.row2; i++) {
+                for (size_t j = q.col1; j <= q.col2; j++) {
+                    s += ref[i][j];
+                    m = max(m, ref[i][j]);
+                }
+            }
+            if (grid.rectSum(q) != s || grid.rectMax(q) != m) wrong++;
+            batch.push_back(q);
+        }
+        vector<long long> s(batch.size());
+        vector<int> m(batch.size());
+        grid.rectSumBatch(batch.data(), batch.size(), s.data());
+        grid.rectMaxBatch(batch.data(), batch.size(), m.data());
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (s[i] != grid.rectSum(batch[i]) || m[i] != grid.rectMax(batch[i])) wrong++;
         }
     }
-    return true;
+    printf("TestGridRangeQuery wrong=%d\n", wrong);
+}
+
+// side x side 的网格：随机大小的矩形和边长不超过 64 的小矩形，求和/最大值/单点修改的耗时，和整块扫描对比
+void BenchGridRangeQuery(size_t side = 4096, size_t nqueries = 1000000) {
+    mt19937 rng(2023);
+    vector<int> cells(side * side);
+    for (auto& x : cells) x = (int)(rng() % 1000000);
+    auto t0 = chrono::steady_clock::now();
+    GridRangeQuery grid(cells, side, side);
+    auto t1 = chrono::steady_clock::now();
+    printf("%zux%zu build=%.1fms\n", side, side, chrono::duration<double, milli>(t1 - t0).count());
+
+    for (size_t maxSide : {side, (size_t)64}) {
+        vector<GridRect> queries(nqueries);
+        for (auto& q : queries) {
+            q.row1 = rng() % side;
+            q.col1 = rng() % side;
+            q.row2 = min(side - 1, q.row1 + rng() % maxSide);
+            q.col2 = min(side - 1, q.col1 + rng() % maxSide);
+        }
+        vector<long long> sums(nqueries);
+        vector<int> maxima(nqueries);
+        t0 = chrono::steady_clock::now();
+        grid.rectSumBatch(queries.data(), nqueries, sums.data());
+        t1 = chrono::steady_clock::now();
+        grid.rectMaxBatch(queries.data(), nqueries, maxima.data());
+        auto t2 = chrono::steady_clock::now();
+        const size_t scans = 1000;
+        long long scanSum = 0, checkSum = 0;
+        for (size_t k = 0; k < scans; k++) {
+            const GridRect& q = queries[k];
+            for (size_t i = q.row1; i <= q.row2; i++) {
+                for (size_t j = q.col1; j <= q.col2; j++) scanSum += cells[i * side + j];
+            }
+            checkSum += sums[k];
+        }
+        auto t3 = chrono::steady_clock::now();
+        long long maxChecksum = 0;
+        for (int m : maxima) maxChecksum += m;
+        printf("rect side <= %4zu: sum=%7.1fns max=%7.1fns full scan=%9.1fns (scan %s) max checksum=%lld\n", maxSide,
+               chrono::duration<double, nano>(t1 - t0).count() / nqueries,
+               chrono::duration<double, nano>(t2 - t1).count() / nqueries,
+               chrono::duration<double, nano>(t3 - t2).count() / scans, scanSum == checkSum ? "agrees" : "DIFFERS",
+               maxChecksum);
+    }
+
+    const size_t nupdates = 1000000;
+    t0 = chrono::steady_clock::now();
+    for (size_t k = 0; k < nupdates; k++) {
+        grid.set(rng() % side, rng() % side, (int)(rng() % 1000000));
+    }
+    t1 = chrono::steady_clock::now();
+    printf("set=%.1fns\n", chrono::duration<double, nano>(t1 - t0).count() / nupdates);
 }
 
 
 
 
-vector<int> d;
+
+
+vector<int> d;   // 线段树，1 号是根，大小开到 4n
+vector<int> a;   // 原数组
 
 
 void build(int s, int t, int p) {
@@ -139,22 +2490,699 @@ int getsum(int l, int r, int s, int t, int p) {
 //  -获取区间的猎头ID列表
 //  -按照积分高低，查找排名在K为的猎头ID
 //  -按照积分高低，查询猎头ID排在第几位
+//
+// 积分在线变化、事先不知道取值，不能像上面那样离散化后开值域线段树，所以排名结构用按子树大小计数的 treap：
+//  - 排序键是 (积分降序, ID 升序)，第 1 名是积分最高的；结点放在连续的结点池里，儿子是 32 位下标，删除的结点进空闲链表复用
+//  - unordered_map 存 ID -> 结点下标，按 ID 查积分 O(1)
+//  - 更新积分 = 删掉旧键再插入新键；排名、第 K 名都是沿着子树大小往下走，期望 O(log n)
+//  - 分页/按积分区间列出 ID：先走到起始名次，路径上记下"往左走过"的祖先，之后按中序往后走，O(log n + N)
+//  - 批量建榜：按键排序后用单调栈 O(n) 建笛卡尔树，不用 n 次插入
+struct HunterEntry {
+    long long id;
+    long long score;
+};
+
+class HunterLeaderboard {
+private:
+    struct Node {
+        long long score;
+        long long id;
+        uint32_t left, right;
+        uint32_t size;
+        uint32_t priority;
+    };
+    vector<Node> pool;                      // pool[0] 是空结点，size = 0
+    uint32_t root;
+    uint32_t freeList;                      // 空闲结点通过 left 串起来
+    unordered_map<long long, uint32_t> index;
+    uint32_t seed;
+
+    uint32_t nextPriority() {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
+
+    // 排在前面：积分高的在前，积分相同 ID 小的在前
+    static bool before(long long scoreA, long long idA, long long scoreB, long long idB) {
+        return scoreA != scoreB ? scoreA > scoreB : idA < idB;
+    }
+
+    void pull(uint32_t t) {
+        pool[t].size = pool[pool[t].left].size + pool[pool[t].right].size + 1;
+    }
+
+    uint32_t newNode(long long id, long long score) {
+        uint32_t t;
+        if (freeList != 0) {
+            t = freeList;
+            freeList = pool[t].left;
+        } else {
+            t = (uint32_t)pool.size();
+            pool.push_back(Node());
+        }
+        pool[t] = Node{score, id, 0, 0, 1, nextPriority()};
+        return t;
+    }
+
+    // 按键把 t 分成 < (score, id) 和 >= (score, id) 两棵
+    void split(uint32_t t, long long score, long long id, uint32_t& l, uint32_t& r) {
+        if (t == 0) {
+            l = r = 0;
+            return;
+        }
+        if (before(pool[t].score, pool[t].id, score, id)) {
+            split(pool[t].right, score, id, pool[t].right, r);
+            l = t;
+        } else {
+            split(pool[t].left, score, id, l, pool[t].left);
+            r = t;
+        }
+        pull(t);
+    }
+
+    uint32_t merge(uint32_t a, uint32_t b) {
+        if (a == 0 || b == 0) return a | b;
+        if (pool[a].priority > pool[b].priority) {
+            pool[a].right = merge(pool[a].right, b);
+            pull(a);
+            return a;
+        }
+        pool[b].left = merge(a, pool[b].left);
+        pull(b);
+        return b;
+    }
+
+    uint32_t insertNode(uint32_t t, uint32_t nd) {
+        if (t == 0) return nd;
+        if (pool[nd].priority > pool[t].priority) {
+            split(t, pool[nd].score, pool[nd].id, pool[nd].left, pool[nd].right);
+            pull(nd);
+            return nd;
+        }
+        if (before(pool[nd].score, pool[nd].id, pool[t].score, pool[t].id)) {
+            pool[t].left = insertNode(pool[t].left, nd);
+        } else {
+            pool[t].right = insertNode(pool[t].right, nd);
+        }
+        pull(t);
+        return t;
+    }
+
+    uint32_t eraseNode(uint32_t t, uint32_t nd) {
+        if (t == nd) return merge(pool[t].left, pool[t].right);
+        if (before(pool[nd].score, pool[nd].id, pool[t].score, pool[t].id)) {
+            pool[t].left = eraseNode(pool[t].left, nd);
+        } else {
+            pool[t].right = eraseNode(pool[t].right, nd);
+        }
+        pull(t);
+        return t;
+    }
+
+    // 中序前缀里满足 pred 的结点个数（pred 沿中序单调：先全为 true 再全为 false）
+    template<typename Pred>
+    size_t countPrefix(Pred pred) const {
+        size_t cnt = 0;
+        for (uint32_t t = root; t != 0; ) {
+            if (pred(pool[t])) {
+                cnt += pool[pool[t].left].size + 1;
+                t = pool[t].right;
+            } else {
+                t = pool[t].left;
+            }
+        }
+        return cnt;
+    }
+
+    // 从第 first 名（从 1 开始）起按名次顺序访问 count 个结点
+    template<typename Visit>
+    void forEachFrom(size_t first, size_t count, Visit visit) const {
+        if (first == 0 || first > size()) return;
+        vector<uint32_t> stack;
+        size_t k = first;
+        for (uint32_t t = root; t != 0; ) {
+            size_t ls = pool[pool[t].left].size;
+            if (k <= ls) {
+                stack.push_back(t);
+                t = pool[t].left;
+            } else if (k == ls + 1) {
+                stack.push_back(t);
+                break;
+            } else {
+                k -= ls + 1;
+                t = pool[t].right;
+            }
+        }
+        while (count > 0 && !stack.empty()) {
+            uint32_t t = stack.back();
+            stack.pop_back();
+            visit(pool[t]);
+            count--;
+            for (uint32_t c = pool[t].right; c != 0; c = pool[c].left) stack.push_back(c);
+        }
+    }
+
+public:
+    explicit HunterLeaderboard(size_t expected = 0) : pool(1, Node{0, 0, 0, 0, 0, 0}), root(0), freeList(0),
+                                                      seed(2463534242u) {
+        pool.reserve(expected + 1);
+        index.reserve(expected);
+    }
+
+    // 批量建榜，ID 不能重复
+    explicit HunterLeaderboard(vector<HunterEntry> entries) : HunterLeaderboard(entries.size()) {
+        sort(entries.begin(), entries.end(), [](const HunterEntry& a, const HunterEntry& b) {
+            return before(a.score, a.id, b.score, b.id);
+        });
+        vector<uint32_t> stack;     // 最右链，优先级从栈底往栈顶递减
+        for (const auto& e : entries) {
+            uint32_t t = newNode(e.id, e.score);
+            bool inserted = index.emplace(e.id, t).second;
+            assert(inserted);
+            uint32_t last = 0;
+            while (!stack.empty() && pool[stack.back()].priority < pool[t].priority) {
+                last = stack.back();
+                stack.pop_back();
+            }
+            pool[t].left = last;
+            if (!stack.empty()) pool[stack.back()].right = t;
+            stack.push_back(t);
+        }
+        if (!stack.empty()) root = stack[0];
+        // 子树大小：按排序顺序建出来的结点，后序遍历一遍
+        vector<pair<uint32_t, bool>> order;
+        if (root != 0) order.push_back({root, false});
+        while (!order.empty()) {
+            auto cur = order.back();
+            order.pop_back();
+            if (cur.second) {
+                pull(cur.first);
+                continue;
+            }
+            order.push_back({cur.first, true});
+            if (pool[cur.first].left != 0) order.push_back({pool[cur.first].left, false});
+            if (pool[cur.first].right != 0) order.push_back({pool[cur.first].right, false});
+        }
+        // 按层序重新编号：上面几层挤在一起，常驻缓存，查询只在最下面几层 cache miss
+        vector<Node> relabeled(pool.size());
+        relabeled[0] = pool[0];
+        vector<uint32_t> bfs;
+        bfs.reserve(entries.size());
+        if (root != 0) bfs.push_back(root);
+        for (size_t i = 0; i < bfs.size(); i++) {
+            uint32_t t = bfs[i];
+            if (pool[t].left != 0) bfs.push_back(pool[t].left);
+            if (pool[t].right != 0) bfs.push_back(pool[t].right);
+        }
+        vector<uint32_t> newId(pool.size(), 0);
+        for (size_t i = 0; i < bfs.size(); i++) newId[bfs[i]] = (uint32_t)(i + 1);
+        for (size_t i = 0; i < bfs.size(); i++) {
+            Node nd = pool[bfs[i]];
+            nd.left = newId[nd.left];
+            nd.right = newId[nd.right];
+            relabeled[i + 1] = nd;
+            index[nd.id] = (uint32_t)(i + 1);
+        }
+        pool.swap(relabeled);
+        root = bfs.empty() ? 0 : 1;
+    }
+
+    size_t size() const {
+        return pool[root].size;
+    }
+
+    bool find(long long id, long long& score) const {
+        auto it = index.find(id);
+        if (it == index.end()) return false;
+        score = pool[it->second].score;
+        return true;
+    }
+
+    // 新 ID 插入，已有 ID 更新积分
+    void update(long long id, long long score) {
+        auto it = index.find(id);
+        if (it != index.end()) {
+            uint32_t t = it->second;
+            if (pool[t].score == score) return;
+            root = eraseNode(root, t);
+            pool[t].left = pool[t].right = 0;
+            pool[t].size = 1;
+            pool[t].score = score;
+            root = insertNode(root, t);
+            return;
+        }
+        uint32_t t = newNode(id, score);
+        index.emplace(id, t);
+        root = insertNode(root, t);
+    }
+
+    bool erase(long long id) {
+        auto it = index.find(id);
+        if (it == index.end()) return false;
+        uint32_t t = it->second;
+        root = eraseNode(root, t);
+        pool[t].left = freeList;
+        freeList = t;
+        index.erase(it);
+        return true;
+    }
+
+    // 名次从 1 开始，ID 不存在返回 0
+    size_t rank(long long id) const {
+        auto it = index.find(id);
+        if (it == index.end()) return 0;
+        const Node& nd = pool[it->second];
+        return countPrefix([&](const Node& x) { return !before(nd.score, nd.id, x.score, x.id); });
+    }
+
+    // 第 k 名（从 1 开始）
+    HunterEntry at(size_t k) const {
+        assert(k >= 1 && k <= size());
+        uint32_t t = root;
+        while (true) {
+            size_t ls = pool[pool[t].left].size;
+            if (k <= ls) {
+                t = pool[t].left;
+            } else if (k == ls + 1) {
+                return HunterEntry{pool[t].id, pool[t].score};
+            } else {
+                k -= ls + 1;
+                t = pool[t].right;
+            }
+        }
+    }
+
+    // 名次在 [first, first + count) 的一页
+    vector<HunterEntry> page(size_t first, size_t count) const {
+        vector<HunterEntry> res;
+        res.reserve(min(count, size()));
+        forEachFrom(first, count, [&](const Node& x) { res.push_back(HunterEntry{x.id, x.score}); });
+        return res;
+    }
+
+    // 积分在 [lo, hi] 的 ID，按名次顺序
+    vector<long long> idsInScoreRange(long long lo, long long hi) const {
+        vector<long long> res;
+        if (lo > hi) return res;
+        size_t higher = countPrefix([&](const Node& x) { return x.score > hi; });
+        size_t atLeast = countPrefix([&](const Node& x) { return x.score >= lo; });
+        res.reserve(atLeast - higher);
+        forEachFrom(higher + 1, atLeast - higher, [&](const Node& x) { res.push_back(x.id); });
+        return res;
+    }
+};
+
+void TestHunterLeaderboard() {
+    mt19937_64 rng(25);
+    int wrong = 0;
+    for (int round = 0; round < 2; round++) {
+        const long long idRange = 600;
+        unordered_map<long long, long long> ref;
+        vector<HunterEntry> init;
+        if (round == 1) {
+            for (long long id = 0; id < idRange; id += 2) init.push_back(HunterEntry{id, (long long)(rng() % 50)});
+            for (const auto& e : init) ref[e.id] = e.score;
+        }
+        HunterLeaderboard board(init);
+        for (int t = 0; t < 20000; t++) {
+            long long id = (long long)(rng() % idRange);
+            int op = (int)(rng() % 4);
+            if (op == 0) {
+                long long score = (long long)(rng() % 50) - 10;
+                board.update(id, score);
+                ref[id] = score;
+            } else if (op == 1) {
+                if (board.erase(id) != (ref.erase(id) == 1)) wrong++;
+            }
+            if (t % 50 != 0) continue;
+            vector<HunterEntry> sorted;
+            for (const auto& kv : ref) sorted.push_back(HunterEntry{kv.first, kv.second});
+            sort(sorted.begin(), sorted.end(), [](const HunterEntry& a, const HunterEntry& b) {
+                return a.score != b.score ? a.score > b.score : a.id < b.id;
+            });
+            if (board.size() != sorted.size()) wrong++;
+            for (size_t i = 0; i < sorted.size(); i++) {
+                long long score;
+                if (!board.find(sorted[i].id, score) || score != sorted[i].score) wrong++;
+                if (board.rank(sorted[i].id) != i + 1) wrong++;
+                HunterEntry e = board.at(i + 1);
+                if (e.id != sorted[i].id || e.score != sorted[i].score) wrong++;
+            }
+            long long score;
+            if (!ref.count(id) && (board.find(id, score) || board.rank(id) != 0)) wrong++;
+            size_t first = rng() % (sorted.size() + 2), count = rng() % 40;
+            vector<HunterEntry> page = board.page(first, count);
+            size_t expect = first == 0 || first > sorted.size() ? 0 : min(count, sorted.size() - first + 1);
+            if (page.size() != expect) wrong++;
+            for (size_t i = 0; i < page.size() && i < expect; i++) {
+                if (page[i].id != sorted[first - 1 + i].id) wrong++;
+            }
+            long long lo = (long long)(rng() % 60) - 15, hi = lo + (long long)(rng() % 20);
+            vector<long long> ids = board.idsInScoreRange(lo, hi), expectIds;
+            for (const auto& s : sorted) if (s.score >= lo && s.score <= hi) expectIds.push_back(s.id);
+            if (ids != expectIds) wrong++;
+        }
+    }
+    printf("TestHunterLeaderboard wrong=%d\n", wrong);
+}
+
+// n 个猎头批量建榜，然后分别测：更新积分、按 ID 查名次、查第 K 名、每页 pageSize 个的分页、删除 + 插入
+void BenchHunterLeaderboard(size_t n = 10000000, size_t nops = 2000000, size_t pageSize = 100) {
+    mt19937_64 rng(2025);
+    vector<HunterEntry> entries(n);
+    for (size_t i = 0; i < n; i++) entries[i] = HunterEntry{(long long)(i * 2654435761ULL % (n * 4)), (long long)(rng() % 1000000)};
+    auto t0 = chrono::steady_clock::now();
+    HunterLeaderboard board(entries);
+    auto t1 = chrono::steady_clock::now();
+    printf("hunters=%zu build=%.1fms\n", n, chrono::duration<double, milli>(t1 - t0).count());
+
+    auto report = [&](const char* name, chrono::steady_clock::time_point start, long long checksum) {
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / nops;
+        printf("%-12s %8.1fns/op checksum=%lld\n", name, ns, checksum);
+    };
+    long long checksum = 0;
+    t0 = chrono::steady_clock::now();
+    for (size_t i = 0; i < nops; i++) {
+        const HunterEntry& e = entries[rng() % n];
+        board.update(e.id, (long long)(rng() % 1000000));
+    }
+    report("update", t0, (long long)board.size());
+
+    checksum = 0;
+    t0 = chrono::steady_clock::now();
+    for (size_t i = 0; i < nops; i++) checksum += (long long)board.rank(entries[rng() % n].id);
+    report("rank", t0, checksum);
+
+    checksum = 0;
+    t0 = chrono::steady_clock::now();
+    for (size_t i = 0; i < nops; i++) checksum += board.at(1 + rng() % n).id;
+    report("at(k)", t0, checksum);
+
+    checksum = 0;
+    t0 = chrono::steady_clock::now();
+    for (size_t i = 0; i < nops; i++) {
+        // 大部分翻的是前几页
+        size_t first = rng() % 4 ? 1 + rng() % 10 * pageSize : 1 + rng() % n;
+        checksum += (long long)board.page(first, pageSize).size();
+    }
+    report("page", t0, checksum);
+
+    checksum = 0;
+    t0 = chrono::steady_clock::now();
+    for (size_t i = 0; i < nops; i++) {
+        const HunterEntry& e = entries[rng() % n];
+        checksum += board.erase(e.id);
+        board.update(e.id, (long long)(rng() % 1000000));
+    }
+    report("erase+insert", t0, checksum);
+}
+
 
 
 // -https://blog.csdn.net/zearot/article/details/48299459
 
 
 // 以组为单位订音乐会的门票 https://leetcode.cn/problems/booking-concert-tickets-in-groups/
+// n 排座位，每排 m 个，每排总是从左往右卖，所以一排的状态就是"还剩几个空座"
+//  - gather(k, maxRow)：找编号最小的、空座 >= k 的排（且 <= maxRow），一次坐下 k 人，返回 {排, 起始座位}
+//  - scatter(k, maxRow)：[0, maxRow] 排的空座总数 >= k 时，从编号小的排开始依次坐满
+// 非递归线段树，结点同时存区间内每排空座的最大值和空座总和：
+//  - gather 从根往下走，左儿子最大值 >= k 就往左，否则往右，O(log n) 找到第一排，不用逐排扫描
+//  - scatter 先用自底向上的前缀和判断够不够，再从 firstFree（之前的排都满了）往后坐满，
+//      每排至多被坐满一次，均摊 O(log n)
+class BookMyShow {
+private:
+    struct Node {
+        long long sum;      // 区间内空座总数，n * m 会超过 int
+        int maxFree;        // 区间内单排空座的最大值
+    };
+    int n, m;
+    int cap;                // 叶子数，2 的幂，多出来的叶子空座为 0
+    int firstFree;          // [0, firstFree) 排都已坐满
+    vector<Node> tree;
+
+    void setFree(int row, int free) {
+        int i = row + cap;
+        tree[i].sum = free;
+        tree[i].maxFree = free;
+        for (i >>= 1; i > 0; i >>= 1) {
+            tree[i].sum = tree[2 * i].sum + tree[2 * i + 1].sum;
+            tree[i].maxFree = max(tree[2 * i].maxFree, tree[2 * i + 1].maxFree);
+        }
+    }
+
+    long long freeSum(int maxRow) const {
+        long long res = 0;
+        for (int l = cap, r = maxRow + cap + 1; l < r; l >>= 1, r >>= 1) {
+            if (l & 1) res += tree[l++].sum;
+            if (r & 1) res += tree[--r].sum;
+        }
+        return res;
+    }
+
+public:
+    BookMyShow(int n, int m) : n(n), m(m), cap(1), firstFree(0) {
+        while (cap < n) cap <<= 1;
+        tree.assign(2 * cap, Node{0, 0});
+        for (int i = 0; i < n; i++) tree[cap + i] = Node{m, m};
+        for (int i = cap - 1; i > 0; i--) {
+            tree[i].sum = tree[2 * i].sum + tree[2 * i + 1].sum;
+            tree[i].maxFree = max(tree[2 * i].maxFree, tree[2 * i + 1].maxFree);
+        }
+    }
+
+    vector<int> gather(int k, int maxRow) {
+        if (tree[1].maxFree < k) return {};
+        int i = 1;
+        while (i < cap) {
+            i = tree[2 * i].maxFree >= k ? 2 * i : 2 * i + 1;
+        }
+        int row = i - cap;
+        if (row > maxRow) return {};
+        int free = tree[i].maxFree;
+        setFree(row, free - k);
+        return {row, m - free};
+    }
+
+    bool scatter(int k, int maxRow) {
+        if (freeSum(maxRow) < k) return false;
+        for (int row = firstFree; k > 0; row++) {
+            int free = tree[row + cap].maxFree;
+            int take = min(free, k);
+            if (take > 0) setFree(row, free - take);
+            k -= take;
+            if (take == free) firstFree = row + 1;
+        }
+        return true;
+    }
+};
+
+// 逐排扫描的朴素版本，用来校验和对比吞吐
+class BookMyShowNaive {
+private:
+    int m;
+    vector<int> used;
+
+public:
+    BookMyShowNaive(int n, int m) : m(m), used(n, 0) {}
+
+    vector<int> gather(int k, int maxRow) {
+        for (int row = 0; row <= maxRow; row++) {
+            if (m - used[row] >= k) {
+                int seat = used[row];
+                used[row] += k;
+                return {row, seat};
+            }
+        }
+        return {};
+    }
+
+    bool scatter(int k, int maxRow) {
+        long long total = 0;
+        for (int row = 0; row <= maxRow; row++) total += m - used[row];
+        if (total < k) return false;
+        for (int row = 0; k > 0; row++) {
+            int take = min(m - used[row], k);
+            used[row] += take;
+            k -= take;
+        }
+        return true;
+    }
+};
+
+void TestBookMyShow() {
+    mt19937 rng(24);
+    int wrong = 0;
+    for (int n : {1, 2, 5, 100, 1000}) {
+        for (int m : {1, 7, 50}) {
+            BookMyShow show(n, m);
+            BookMyShowNaive naive(n, m);
+            for (int t = 0; t < 5000; t++) {
+                int k = (int)(rng() % (m + 2)) + 1;
+                int maxRow = (int)(rng() % n);
+                if (rng() % 2) {
+                    if (show.gather(k, maxRow) != naive.gather(k, maxRow)) wrong++;
+                } else {
+                    if (show.scatter(k, maxRow) != naive.scatter(k, maxRow)) wrong++;
+                }
+            }
+        }
+    }
+    printf("TestBookMyShow wrong=%d\n", wrong);
+}
+
+// n 排 * m 座，先用 nops 次请求跑满；请求混合：gatherPercent% 是 gather（团体 2~10 人），其余是 scatter（1~4 人），
+// maxRow 偏向前排（一半请求只接受前 10% 的排）。朴素版本只跑前 naiveOps 次
+void BenchBookMyShow(int n = 100000, int m = 1000, size_t nops = 10000000, int gatherPercent = 70,
+                     size_t naiveOps = 20000) {
+    struct Op { bool gather; int k, maxRow; };
+    mt19937 rng(2024);
+    vector<Op> ops(nops);
+    for (auto& op : ops) {
+        op.gather = (int)(rng() % 100) < gatherPercent;
+        op.k = op.gather ? 2 + (int)(rng() % 9) : 1 + (int)(rng() % 4);
+        op.maxRow = rng() % 2 ? (int)(rng() % max(1, n / 10)) : (int)(rng() % n);
+    }
+
+    auto run = [&](auto& show, size_t count, const char* name) {
+        long long checksum = 0, fails = 0;
+        auto t0 = chrono::steady_clock::now();
+        for (size_t i = 0; i < count; i++) {
+            const Op& op = ops[i];
+            if (op.gather) {
+                vector<int> res = show.gather(op.k, op.maxRow);
+                if (res.empty()) fails++;
+                else checksum += res[0] + res[1];
+            } else {
+                if (show.scatter(op.k, op.maxRow)) checksum++;
+                else fails++;
+            }
+        }
+        auto t1 = chrono::steady_clock::now();
+        double ns = chrono::duration<double, nano>(t1 - t0).count() / count;
+        printf("%-16s %8.1fns/op %10.2fM ops/s failed=%lld checksum=%lld\n", name, ns, 1e3 / ns, fails, checksum);
+    };
+
+    printf("rows=%d seats=%d gather=%d%%\n", n, m, gatherPercent);
+    {
+        BookMyShow show(n, m);
+        run(show, nops, "segment tree");
+    }
+    {
+        BookMyShow show(n, m);
+        run(show, naiveOps, "segment tree");
+        BookMyShowNaive naive(n, m);
+        run(naive, naiveOps, "naive scan");
+    }
+}
+
 
 // 我的日程安排表 III
 // 线段树 懒标记标记区间 [l,r] 进行累加的次数，tree 记录区间 [l,r] 的最大值
+//
+// 动态开点线段树：值域 [0, 1e9] 太大，不能开满数组，只创建被访问到的结点。
+//  - 结点放在一个连续的 vector 结点池里，儿子是 32 位下标，0 号结点是"空儿子"（最大值为 0），
+//      不用 unordered_map 按堆下标查找（每次 book 大约 60 次 hash 查找，而且 2 * idx 超过 int 就溢出了）
+//  - 标记永久化：区间加的 add 留在结点上不往下推，maxVal = add + max(左儿子, 右儿子)，
+//      查询时把路径上的 add 累加起来。所以只有修改会创建结点，查询不会
+class DynamicSegmentTree {
+private:
+    struct Node {
+        int maxVal;     // 子树内的最大值，已经包含本结点的 add
+        int add;        // 整个区间一起加了多少
+        uint32_t left;
+        uint32_t right;
+    };
+    vector<Node> pool;  // pool[0] 是空结点，pool[1] 是根
+    long long lo, hi;
+
+    uint32_t newNode() {
+        pool.push_back(Node{0, 0, 0, 0});
+        return (uint32_t)(pool.size() - 1);
+    }
+
+    void update(uint32_t p, long long l, long long r, long long ql, long long qr, int val) {
+        if (ql <= l && r <= qr) {
+            pool[p].maxVal += val;
+            pool[p].add += val;
+            return;
+        }
+        long long m = l + (r - l) / 2;
+        if (ql <= m) {
+            if (pool[p].left == 0) {
+                uint32_t child = newNode();     // newNode 可能让 pool 扩容，先拿到下标再写回
+                pool[p].left = child;
+            }
+            update(pool[p].left, l, m, ql, qr, val);
+        }
+        if (qr > m) {
+            if (pool[p].right == 0) {
+                uint32_t child = newNode();
+                pool[p].right = child;
+            }
+            update(pool[p].right, m + 1, r, ql, qr, val);
+        }
+        pool[p].maxVal = pool[p].add + max(pool[pool[p].left].maxVal, pool[pool[p].right].maxVal);
+    }
+
+    int query(uint32_t p, long long l, long long r, long long ql, long long qr) const {
+        if (p == 0 || (ql <= l && r <= qr)) {
+            return pool[p].maxVal;
+        }
+        long long m = l + (r - l) / 2;
+        int res = numeric_limits<int>::min();
+        if (ql <= m) res = max(res, query(pool[p].left, l, m, ql, qr));
+        if (qr > m) res = max(res, query(pool[p].right, m + 1, r, ql, qr));
+        return res + pool[p].add;
+    }
+
+public:
+    // 值域 [lo, hi]，所有位置初始为 0；expectedNodes 用来预留结点池
+    DynamicSegmentTree(long long lo, long long hi, size_t expectedNodes = 0) : lo(lo), hi(hi) {
+        pool.reserve(max(expectedNodes, (size_t)2));
+        pool.push_back(Node{0, 0, 0, 0});
+        newNode();
+    }
+
+    void rangeAdd(long long left, long long right, int val) {
+        update(1, lo, hi, left, right, val);
+    }
+
+    int queryMax(long long left, long long right) const {
+        return query(1, lo, hi, left, right);
+    }
+
+    int globalMax() const {
+        return pool[1].maxVal;
+    }
+
+    size_t nodeCount() const {
+        return pool.size() - 1;
+    }
+};
+
 class MyCalendarThree {
 public:
-    unordered_map<int, pair<int, int>> tree;
+    DynamicSegmentTree tree;
+
+    MyCalendarThree() : tree(0, 1e9) {}
+
+    int book(int start, int end) {
+        tree.rangeAdd(start, end - 1, 1);
+        return tree.globalMax();
+    }
+};
+
+// 原来的写法：unordered_map 按堆下标存结点。下标改成 long long，否则深度超过 30 时 2 * idx 溢出；留着做性能对比
+class MyCalendarThreeHashMap {
+public:
+    unordered_map<long long, pair<int, int>> tree;
 
-    MyCalendarThree() {}
+    MyCalendarThreeHashMap() {}
 
-    void update(int start, int end, int l, int r, int idx) {
+    void update(int start, int end, int l, int r, long long idx) {
         if (r < start || end < l) {
             return;
         }
@@ -175,6 +3203,123 @@ public:
     }
 };
 
+// 离线模式：事先拿到全部的预订 [start, end)，把端点离散化成 m 个坐标，
+//  相邻坐标之间的 m - 1 个小区间就是数组的下标，用静态数组的 SegmentTree（最大值 + 区间加）代替动态开点。
+//  返回每次预订之后的最大重叠数，和依次调用 MyCalendarThree::book 的结果一样；nodes 不为空时写入线段树的结点数
+vector<int> MyCalendarThreeOffline(const vector<pair<int, int>>& bookings, size_t* nodes = NULL) {
+    vector<int> coords;
+    coords.reserve(bookings.size() * 2);
+    for (const auto& b : bookings) {
+        coords.push_back(b.first);
+        coords.push_back(b.second);
+    }
+    sort(coords.begin(), coords.end());
+    coords.erase(unique(coords.begin(), coords.end()), coords.end());
+
+    vector<int> res;
+    res.reserve(bookings.size());
+    if (nodes) *nodes = 0;
+    if (coords.size() < 2) {
+        res.assign(bookings.size(), 0);
+        return res;
+    }
+    size_t m = coords.size() - 1;
+    SegmentTree<int, MaxMonoid<int>, AssignAddLazy<int>> tree(m);
+    if (nodes) {
+        size_t cap = 1;
+        while (cap < m) cap <<= 1;
+        *nodes = 2 * cap;
+    }
+    for (const auto& b : bookings) {
+        size_t l = lower_bound(coords.begin(), coords.end(), b.first) - coords.begin();
+        size_t r = lower_bound(coords.begin(), coords.end(), b.second) - coords.begin();
+        if (l < r) tree.rangeAdd(l, r - 1, 1);
+        res.push_back(tree.query(0, m - 1));
+    }
+    return res;
+}
+
+// 暴力：每次预订之后把所有 [start, end) 按端点扫一遍，同一坐标先结束再开始
+int MyCalendarThreeBruteForce(const vector<pair<int, int>>& bookings, size_t count) {
+    vector<pair<int, int>> events;
+    for (size_t i = 0; i < count; i++) {
+        events.push_back({bookings[i].first, 1});
+        events.push_back({bookings[i].second, -1});
+    }
+    sort(events.begin(), events.end());
+    int cur = 0, best = 0;
+    for (const auto& e : events) {
+        cur += e.second;
+        best = max(best, cur);
+    }
+    return best;
+}
+
+void TestMyCalendarThree() {
+    mt19937 rng(17);
+    int wrong = 0;
+    for (int round = 0; round < 200; round++) {
+        // 坐标取自一个小集合：两端 0、1e9 和它们的邻居，加几个随机点，这样很容易出现相邻、重叠、完全相同的预订
+        vector<int> pool = {0, 1, 2, 999999998, 999999999, 1000000000};
+        for (int i = 0; i < 6; i++) pool.push_back((int)(rng() % 1000000001));
+        for (int i = 0; i < 4; i++) pool.push_back((int)(rng() % 20));
+        vector<pair<int, int>> bookings;
+        while (bookings.size() < 60) {
+            int a = pool[rng() % pool.size()], b = pool[rng() % pool.size()];
+            if (a == b) continue;
+            bookings.push_back({min(a, b), max(a, b)});
+        }
+        MyCalendarThree cal;
+        MyCalendarThreeHashMap calMap;
+        vector<int> offline = MyCalendarThreeOffline(bookings);
+        for (size_t i = 0; i < bookings.size(); i++) {
+            int expect = MyCalendarThreeBruteForce(bookings, i + 1);
+            if (cal.book(bookings[i].first, bookings[i].second) != expect) wrong++;
+            if (calMap.book(bookings[i].first, bookings[i].second) != expect) wrong++;
+            if (offline[i] != expect) wrong++;
+        }
+    }
+    printf("TestMyCalendarThree wrong=%d\n", wrong);
+}
+
+void BenchMyCalendarThree(size_t n = 200000) {
+    mt19937 rng(1000000007);
+    vector<pair<int, int>> bookings(n);
+    for (auto& b : bookings) {
+        b.first = rng() % 1000000000;
+        b.second = b.first + 1 + rng() % 10000000;
+    }
+
+    long long checksum = 0;
+    auto t0 = chrono::steady_clock::now();
+    {
+        MyCalendarThreeHashMap cal;
+        for (const auto& b : bookings) checksum += cal.book(b.first, b.second);
+        auto t1 = chrono::steady_clock::now();
+        printf("%-24s %8.1fns/book nodes=%9zu checksum=%lld\n", "unordered_map",
+               chrono::duration<double, nano>(t1 - t0).count() / n, cal.tree.size(), checksum);
+    }
+
+    checksum = 0;
+    t0 = chrono::steady_clock::now();
+    {
+        MyCalendarThree cal;
+        for (const auto& b : bookings) checksum += cal.book(b.first, b.second);
+        auto t1 = chrono::steady_clock::now();
+        printf("%-24s %8.1fns/book nodes=%9zu checksum=%lld\n", "DynamicSegmentTree",
+               chrono::duration<double, nano>(t1 - t0).count() / n, cal.tree.nodeCount(), checksum);
+    }
+
+    checksum = 0;
+    size_t nodes = 0;
+    t0 = chrono::steady_clock::now();
+    vector<int> res = MyCalendarThreeOffline(bookings, &nodes);
+    auto t1 = chrono::steady_clock::now();
+    for (int x : res) checksum += x;
+    printf("%-24s %8.1fns/book nodes=%9zu checksum=%lld\n", "offline (compressed)",
+           chrono::duration<double, nano>(t1 - t0).count() / n, nodes, checksum);
+}
+
 
 
 #endif //ALGORITHM_ADVANCED_SEGMENT_TREE_H